@@ -0,0 +1,141 @@
+// Elementary Cellular Automaton - domain decomposition
+// Szymon Golebiowski
+
+#include "distributed.h"
+#include "eca.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the initial state of a cell depends only on the seed and its position, so
+// that every process can generate its slice independently
+static int initial_cell(const struct eca_distributed_config *config, long long cell) {
+
+    unsigned long long hash = eca_mix(config->seed ^ eca_mix((unsigned long long)cell));
+
+    return (long long)(hash % (unsigned long long)config->columns_num) <
+           config->population_size;
+}
+
+// the first cell of the slice of the given process
+static long long slice_begin(long long columns_num, int processes_num, int rank) {
+
+    // columns_num * rank / processes_num without overflowing for huge rings
+    return columns_num / processes_num * rank +
+           columns_num % processes_num * rank / processes_num;
+}
+
+// eca_calculate_cells indexes the cells with int, so slices longer than that
+// are calculated in pieces
+static void calculate_cells(const unsigned char *upper, unsigned char *row,
+                            long long begin, long long end, int rule) {
+
+    while (begin < end) {
+
+        long long length = end - begin;
+        if (length > INT_MAX - 1) {
+            length = INT_MAX - 1;
+        }
+
+        eca_calculate_cells(&upper[begin], &row[begin], 0, (int)length, rule);
+        begin += length;
+    }
+}
+
+int eca_run_distributed(struct eca_transport *transport,
+                        const struct eca_distributed_config *config,
+                        struct eca_distributed_result *result) {
+
+    long long begin = slice_begin(config->columns_num, transport->processes_num,
+                                  transport->rank);
+    long long end = slice_begin(config->columns_num, transport->processes_num,
+                                transport->rank + 1);
+
+    long long width = end - begin;
+    int halo = config->halo_size;
+
+    // halos are taken from the immediate neighbours only, so every slice has to
+    // be at least as wide as a halo, all processes check the same condition and
+    // none of them is left waiting for the others
+    if (config->columns_num < (long long)transport->processes_num * halo) {
+
+        if (transport->rank == 0) {
+            fprintf(stderr, "%lld columns cannot be split into %d slices of at "
+                            "least %d cells\n",
+                    config->columns_num, transport->processes_num, halo);
+        }
+
+        transport->abort(transport);
+    }
+
+    // [0, halo) left halo, [halo, halo + width) own cells, then right halo
+    long long length = width + 2 * halo;
+    unsigned char *cells = (unsigned char *)calloc(length, 1);
+    unsigned char *next = (unsigned char *)calloc(length, 1);
+    unsigned char *from_left = (unsigned char *)malloc(halo);
+    unsigned char *from_right = (unsigned char *)malloc(halo);
+
+    if (cells == NULL || next == NULL || from_left == NULL || from_right == NULL) {
+        fprintf(stderr, "Process %d: not enough memory for %lld columns\n",
+                transport->rank, width);
+        transport->abort(transport);
+    }
+
+    for (long long i = 0; i < width; i++) {
+        cells[halo + i] = initial_cell(config, begin + i);
+    }
+
+    // the initial row is the first iteration
+    int error = 0;
+    long long iteration = 1;
+
+    while (iteration < config->iterations_num && !error) {
+
+        // the last block may be shorter than the halo
+        int steps = halo;
+        if (config->iterations_num - iteration < steps) {
+            steps = (int)(config->iterations_num - iteration);
+        }
+
+        error = transport->exchange(transport, &cells[halo],
+                                    &cells[halo + width - steps], from_left,
+                                    from_right, steps);
+
+        memcpy(&cells[halo - steps], from_left, steps);
+        memcpy(&cells[halo + width], from_right, steps);
+
+        // the valid region shrinks by one cell on each side per generation
+        for (int step = 1; step <= steps; step++) {
+
+            calculate_cells(cells, next, halo - steps + step,
+                            halo + width + steps - step, config->rule);
+
+            unsigned char *swap = cells;
+            cells = next;
+            next = swap;
+        }
+
+        iteration += steps;
+    }
+
+    unsigned long long population = 0, checksum = 0;
+    for (long long i = 0; i < width; i++) {
+        if (cells[halo + i]) {
+            population++;
+            checksum += eca_mix((unsigned long long)(begin + i));
+        }
+    }
+
+    if (!error) {
+        result->population = transport->reduce(transport, population);
+        result->checksum = transport->reduce(transport, checksum);
+    }
+
+    free(cells);
+    free(next);
+    free(from_left);
+    free(from_right);
+
+    return error;
+}
@@ -0,0 +1,45 @@
+// Elementary Cellular Automaton - domain decomposition
+// Szymon Golebiowski
+
+#ifndef ECA_DISTRIBUTED_H
+#define ECA_DISTRIBUTED_H
+
+#include "transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// every process owns a contiguous slice of the ring and keeps only its
+// current and next generation, the neighbouring cells are exchanged with the
+// neighbours as halos of halo_size cells, once per halo_size generations,
+// iterations_num counts the initial row, as in the other modes
+struct eca_distributed_config {
+
+    int rule;
+    long long columns_num;
+    long long iterations_num;
+    long long population_size;
+    int halo_size;
+    unsigned long long seed;
+};
+
+// summary of the last generation, the same for every decomposition
+struct eca_distributed_result {
+
+    unsigned long long population;
+    unsigned long long checksum;
+};
+
+// run the simulation in the calling process, the result is valid in process 0,
+// all processes are aborted if the ring is narrower than processes_num halos
+// or a slice does not fit in memory, returns 0 on success
+int eca_run_distributed(struct eca_transport *transport,
+                        const struct eca_distributed_config *config,
+                        struct eca_distributed_result *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
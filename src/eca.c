@@ -0,0 +1,434 @@
+// Elementary Cellular Automaton - simulation library
+// Szymon Golebiowski
+
+#include "eca.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct eca_context {
+
+    int rule;
+    int columns_num;
+    long long iteration;
+
+    unsigned char *row;
+    unsigned char *next_row;
+    int own_buffers;
+};
+
+unsigned long long eca_mix(unsigned long long x) {
+
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
+
+// SplitMix64, a small generator whose whole state is kept by the caller
+static unsigned long long next_random(unsigned long long *random_state) {
+
+    unsigned long long x = *random_state;
+    *random_state += 0x9e3779b97f4a7c15ULL;
+
+    return eca_mix(x);
+}
+
+void eca_pack_row(const unsigned char *row, unsigned char *packed, int columns_num) {
+
+    memset(packed, 0, (columns_num + 7) / 8);
+    for (int i = 0; i < columns_num; i++) {
+        packed[i / 8] |= row[i] << (i % 8);
+    }
+}
+
+void eca_unpack_row(const unsigned char *packed, unsigned char *row, int columns_num) {
+
+    for (int i = 0; i < columns_num; i++) {
+        row[i] = (packed[i / 8] >> (i % 8)) & 1;
+    }
+}
+
+int eca_calculate_cell(int upper_left, int upper_middle, int upper_right, int rule) {
+
+    int upper_cells_type = 4 * upper_left + 2 * upper_middle + upper_right;
+
+    if (rule & (1 << upper_cells_type)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+void eca_calculate_cells(const unsigned char *upper, unsigned char *row, int begin,
+                         int end, int rule) {
+
+    for (int cell_num = begin; cell_num < end; cell_num++) {
+        row[cell_num] = eca_calculate_cell(upper[cell_num - 1], upper[cell_num],
+                                           upper[cell_num + 1], rule);
+    }
+}
+
+void eca_calculate_row(const unsigned char *upper, unsigned char *row,
+                       int columns_num, int rule) {
+
+    if (columns_num == 1) {
+        row[0] = eca_calculate_cell(upper[0], upper[0], upper[0], rule);
+        return;
+    }
+
+    // the first and the last cell are neighbours on the ring
+    row[0] = eca_calculate_cell(upper[columns_num - 1], upper[0], upper[1], rule);
+    eca_calculate_cells(upper, row, 1, columns_num - 1, rule);
+    row[columns_num - 1] = eca_calculate_cell(upper[columns_num - 2],
+                                              upper[columns_num - 1], upper[0], rule);
+}
+
+void eca_random_row(unsigned char *row, int columns_num, int population_size,
+                    unsigned long long *random_state) {
+
+    // every cell is selected with the probability of the number of cells still
+    // needed divided by the number of cells left
+    int needed = population_size;
+    for (int cell_num = 0; cell_num < columns_num; cell_num++) {
+
+        int left = columns_num - cell_num;
+        double random = (next_random(random_state) >> 11) * (1.0 / 9007199254740992.0);
+
+        if (random * left < needed) {
+            row[cell_num] = 1;
+            needed--;
+        } else {
+            row[cell_num] = 0;
+        }
+    }
+}
+
+static struct eca_context *create_context(const struct eca_config *config,
+                                          unsigned char *row,
+                                          unsigned char *next_row, int own_buffers) {
+
+    struct eca_context *context =
+        (struct eca_context *)malloc(sizeof(struct eca_context));
+    if (context == NULL) {
+        return NULL;
+    }
+
+    context->rule = config->rule;
+    context->columns_num = config->columns_num;
+    context->iteration = 0;
+    context->row = row;
+    context->next_row = next_row;
+    context->own_buffers = own_buffers;
+
+    unsigned long long random_state = config->seed;
+    eca_random_row(row, config->columns_num, config->population_size, &random_state);
+
+    return context;
+}
+
+static int is_correct_config(const struct eca_config *config) {
+
+    return 0 <= config->rule && config->rule <= 255 && config->columns_num >= 1 &&
+           0 <= config->population_size &&
+           config->population_size <= config->columns_num;
+}
+
+struct eca_context *eca_create(const struct eca_config *config) {
+
+    if (!is_correct_config(config)) {
+        return NULL;
+    }
+
+    unsigned char *row = (unsigned char *)malloc(config->columns_num);
+    unsigned char *next_row = (unsigned char *)malloc(config->columns_num);
+
+    struct eca_context *context = NULL;
+    if (row != NULL && next_row != NULL) {
+        context = create_context(config, row, next_row, 1);
+    }
+
+    if (context == NULL) {
+        free(row);
+        free(next_row);
+    }
+
+    return context;
+}
+
+struct eca_context *eca_create_with_buffers(const struct eca_config *config,
+                                            unsigned char *row,
+                                            unsigned char *next_row) {
+
+    if (!is_correct_config(config) || row == NULL || next_row == NULL) {
+        return NULL;
+    }
+
+    return create_context(config, row, next_row, 0);
+}
+
+void eca_step(struct eca_context *context, long long iterations_num) {
+
+    for (long long i = 0; i < iterations_num; i++) {
+
+        eca_calculate_row(context->row, context->next_row, context->columns_num,
+                          context->rule);
+
+        unsigned char *swap = context->row;
+        context->row = context->next_row;
+        context->next_row = swap;
+        context->iteration++;
+    }
+}
+
+long long eca_iteration(const struct eca_context *context) {
+    return context->iteration;
+}
+
+int eca_columns_num(const struct eca_context *context) {
+    return context->columns_num;
+}
+
+int eca_rule(const struct eca_context *context) { return context->rule; }
+
+const unsigned char *eca_row(const struct eca_context *context) {
+    return context->row;
+}
+
+void eca_get_row(const struct eca_context *context, unsigned char *row) {
+    memcpy(row, context->row, context->columns_num);
+}
+
+void eca_set_row(struct eca_context *context, const unsigned char *row) {
+
+    memmove(context->row, row, context->columns_num);
+    context->iteration = 0;
+}
+
+void eca_destroy(struct eca_context *context) {
+
+    if (context->own_buffers) {
+        free(context->row);
+        free(context->next_row);
+    }
+
+    free(context);
+}
+
+struct eca_history {
+
+    int rule;
+    int columns_num;
+    int rows_num;
+
+    unsigned char *cells; // rows_num rows of columns_num cells
+    struct eca_span *dirty;
+    long long calculated;
+};
+
+// allocate a history starting with the given row, or with the random row of the
+// configuration if it is NULL, and calculate all the following rows
+static struct eca_history *create_history(const struct eca_config *config,
+                                          int rows_num, const unsigned char *row) {
+
+    if (!is_correct_config(config) || rows_num < 1) {
+        return NULL;
+    }
+
+    struct eca_history *history =
+        (struct eca_history *)malloc(sizeof(struct eca_history));
+    if (history == NULL) {
+        return NULL;
+    }
+
+    history->rule = config->rule;
+    history->columns_num = config->columns_num;
+    history->rows_num = rows_num;
+    history->cells = (unsigned char *)malloc((size_t)rows_num * config->columns_num);
+    history->dirty = (struct eca_span *)calloc(rows_num, sizeof(struct eca_span));
+    history->calculated = 0;
+
+    if (history->cells == NULL || history->dirty == NULL) {
+        eca_history_destroy(history);
+        return NULL;
+    }
+
+    if (row != NULL) {
+        memcpy(history->cells, row, config->columns_num);
+    } else {
+        unsigned long long random_state = config->seed;
+        eca_random_row(history->cells, config->columns_num, config->population_size,
+                       &random_state);
+    }
+
+    for (int i = 1; i < rows_num; i++) {
+
+        size_t offset = (size_t)i * config->columns_num;
+        eca_calculate_row(&history->cells[offset - config->columns_num],
+                          &history->cells[offset], config->columns_num,
+                          config->rule);
+    }
+
+    return history;
+}
+
+struct eca_history *eca_history_create(const struct eca_config *config,
+                                       int rows_num) {
+
+    return create_history(config, rows_num, NULL);
+}
+
+struct eca_history *eca_history_create_from_row(const struct eca_config *config,
+                                                int rows_num,
+                                                const unsigned char *row) {
+
+    return create_history(config, rows_num, row);
+}
+
+int eca_history_rows_num(const struct eca_history *history) {
+    return history->rows_num;
+}
+
+int eca_history_columns_num(const struct eca_history *history) {
+    return history->columns_num;
+}
+
+const unsigned char *eca_history_row(const struct eca_history *history, int row) {
+    return &history->cells[(size_t)row * history->columns_num];
+}
+
+// write the cells of the span into the row and narrow the span to the ones
+// which have changed, returns their number, the cells are copied from new_row
+// or calculated from the upper row if new_row is NULL
+static int update_span(unsigned char *row, int columns_num, struct eca_span *span,
+                       const unsigned char *new_row, const unsigned char *upper,
+                       int rule) {
+
+    int first = -1, last = -1, changed = 0;
+
+    // the longest run of unchanged cells between two changed ones
+    int gap_begin = 0, gap_length = 0;
+
+    for (int offset = 0; offset < span->length; offset++) {
+
+        int column = (span->begin + offset) % columns_num;
+
+        int cell;
+        if (new_row != NULL) {
+            cell = new_row[column];
+        } else {
+            cell = eca_calculate_cell(upper[(column + columns_num - 1) % columns_num],
+                                      upper[column], upper[(column + 1) % columns_num],
+                                      rule);
+        }
+
+        if (cell == row[column]) {
+            continue;
+        }
+
+        row[column] = cell;
+        changed++;
+
+        if (first < 0) {
+            first = offset;
+        } else if (offset - last - 1 > gap_length) {
+            gap_begin = last + 1;
+            gap_length = offset - last - 1;
+        }
+        last = offset;
+    }
+
+    if (changed == 0) {
+        span->length = 0;
+        return 0;
+    }
+
+    // on the whole ring the changed cells may wrap around the first column,
+    // then the longest gap is left out instead of the cells around it
+    if (span->length == columns_num &&
+        gap_length > first + columns_num - 1 - last) {
+        span->begin = (span->begin + gap_begin + gap_length) % columns_num;
+        span->length = columns_num - gap_length;
+        return changed;
+    }
+
+    span->begin = (span->begin + first) % columns_num;
+    span->length = last - first + 1;
+
+    return changed;
+}
+
+int eca_history_set_first_row(struct eca_history *history,
+                              const unsigned char *row) {
+
+    int columns_num = history->columns_num;
+    memset(history->dirty, 0, history->rows_num * sizeof(struct eca_span));
+    history->calculated = 0;
+
+    struct eca_span span = {0, columns_num};
+    if (update_span(history->cells, columns_num, &span, row, NULL, history->rule) ==
+        0) {
+        return 0;
+    }
+    history->dirty[0] = span;
+
+    int rows_changed = 1;
+    for (; rows_changed < history->rows_num; rows_changed++) {
+
+        // only the neighbours of the changed cells may change
+        span.begin = (span.begin + columns_num - 1) % columns_num;
+        span.length += 2;
+        if (span.length >= columns_num) {
+            span.begin = 0;
+            span.length = columns_num;
+        }
+
+        history->calculated += span.length;
+
+        unsigned char *current =
+            &history->cells[(size_t)rows_changed * columns_num];
+        if (update_span(current, columns_num, &span, NULL, current - columns_num,
+                        history->rule) == 0) {
+            break;
+        }
+
+        history->dirty[rows_changed] = span;
+    }
+
+    return rows_changed;
+}
+
+int eca_history_flip(struct eca_history *history, int column) {
+
+    if (column < 0 || column >= history->columns_num) {
+        return -1;
+    }
+
+    unsigned char *row = (unsigned char *)malloc(history->columns_num);
+    if (row == NULL) {
+        return -1;
+    }
+
+    memcpy(row, history->cells, history->columns_num);
+    row[column] = !row[column];
+
+    int rows_changed = eca_history_set_first_row(history, row);
+    free(row);
+
+    return rows_changed;
+}
+
+const struct eca_span *eca_history_dirty(const struct eca_history *history) {
+    return history->dirty;
+}
+
+long long eca_history_calculated(const struct eca_history *history) {
+    return history->calculated;
+}
+
+void eca_history_destroy(struct eca_history *history) {
+
+    free(history->cells);
+    free(history->dirty);
+    free(history);
+}
@@ -0,0 +1,133 @@
+// Elementary Cellular Automaton - simulation library
+// Szymon Golebiowski
+
+#ifndef ECA_H
+#define ECA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A simulation context holds the rule and the current row of a ring. Cells are
+// bytes equal to 0 or 1. Contexts do not share any state, so different
+// contexts may be used concurrently from different threads.
+struct eca_context;
+
+struct eca_config {
+
+    int rule;                // transition rule, [0, 255]
+    int columns_num;         // number of cells of the ring
+    int population_size;     // number of live cells of the random initial row
+    unsigned long long seed; // seed of the random initial row
+};
+
+// calculate the state of the given cell on the basis of its upper neighbours
+int eca_calculate_cell(int upper_left, int upper_middle, int upper_right, int rule);
+
+// calculate the cells [begin, end) of a row on the basis of the upper row, the
+// upper row has to contain the cells begin - 1 and end
+void eca_calculate_cells(const unsigned char *upper, unsigned char *row, int begin,
+                         int end, int rule);
+
+// calculate the next row of a ring
+void eca_calculate_row(const unsigned char *upper, unsigned char *row,
+                       int columns_num, int rule);
+
+// fill the row with exactly population_size randomly placed live cells, the
+// state of the random number generator is updated
+void eca_random_row(unsigned char *row, int columns_num, int population_size,
+                    unsigned long long *random_state);
+
+// SplitMix64 finalizer, it turns consecutive numbers such as the positions of
+// cells into unrelated ones
+unsigned long long eca_mix(unsigned long long x);
+
+// pack a row into (columns_num + 7) / 8 bytes, cell i is the bit i % 8 of the
+// byte i / 8, the unused bits of the last byte are cleared
+void eca_pack_row(const unsigned char *row, unsigned char *packed, int columns_num);
+
+// unpack a row packed by eca_pack_row
+void eca_unpack_row(const unsigned char *packed, unsigned char *row, int columns_num);
+
+// create a context with a random initial row, returns NULL on incorrect
+// configuration or when out of memory
+struct eca_context *eca_create(const struct eca_config *config);
+
+// create a context which works on two rows of columns_num cells provided by the
+// caller, the current row is always one of them
+struct eca_context *eca_create_with_buffers(const struct eca_config *config,
+                                            unsigned char *row,
+                                            unsigned char *next_row);
+
+// calculate the given number of next iterations
+void eca_step(struct eca_context *context, long long iterations_num);
+
+// number of iterations calculated so far
+long long eca_iteration(const struct eca_context *context);
+
+int eca_columns_num(const struct eca_context *context);
+int eca_rule(const struct eca_context *context);
+
+// the current row, valid until the next call of eca_step
+const unsigned char *eca_row(const struct eca_context *context);
+
+// copy the current row into the given buffer of columns_num cells
+void eca_get_row(const struct eca_context *context, unsigned char *row);
+
+// replace the current row and restart counting the iterations
+void eca_set_row(struct eca_context *context, const unsigned char *row);
+
+// free the context, the buffers provided by the caller are not freed
+void eca_destroy(struct eca_context *context);
+
+// A history keeps the whole space-time diagram of rows_num rows. When its
+// first row is edited only the light cone of the edited cells is calculated
+// again: the changed part of every row widens by at most one cell on each
+// side, and the calculation stops at the first row which has not changed,
+// since all the following ones stay the same.
+struct eca_history;
+
+// cells begin, begin + 1, ..., begin + length - 1 of a row, modulo the number
+// of columns, the length is 0 if the row has not changed
+struct eca_span {
+
+    int begin;
+    int length;
+};
+
+// create a history starting with a random row, returns NULL on incorrect
+// configuration or when out of memory
+struct eca_history *eca_history_create(const struct eca_config *config, int rows_num);
+
+// create a history starting with the given row of columns_num cells, the
+// population size and the seed of the configuration are ignored
+struct eca_history *eca_history_create_from_row(const struct eca_config *config,
+                                                int rows_num,
+                                                const unsigned char *row);
+
+int eca_history_rows_num(const struct eca_history *history);
+int eca_history_columns_num(const struct eca_history *history);
+
+const unsigned char *eca_history_row(const struct eca_history *history, int row);
+
+// replace the first row and update the following ones, returns the number of
+// rows which have changed (the rows after them are the same as before)
+int eca_history_set_first_row(struct eca_history *history, const unsigned char *row);
+
+// flip one cell of the first row, returns the number of changed rows, or -1
+// if the column is outside [0, columns_num) or when out of memory
+int eca_history_flip(struct eca_history *history, int column);
+
+// the changed cells of every row after the last update, rows_num spans
+const struct eca_span *eca_history_dirty(const struct eca_history *history);
+
+// number of cells calculated during the last update
+long long eca_history_calculated(const struct eca_history *history);
+
+void eca_history_destroy(struct eca_history *history);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
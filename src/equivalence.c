@@ -0,0 +1,110 @@
+// Elementary Cellular Automaton - rule equivalence classes
+// Szymon Golebiowski
+
+#include "equivalence.h"
+#include <stddef.h>
+
+int eca_transform_rule(int rule, int transform) {
+
+    int result = 0;
+
+    for (int neighbourhood = 0; neighbourhood < 8; neighbourhood++) {
+
+        // the neighbourhood seen by the original rule
+        int original = neighbourhood;
+        if (transform & ECA_TRANSFORM_MIRROR) {
+            original = ((original & 1) << 2) | (original & 2) | (original >> 2);
+        }
+        if (transform & ECA_TRANSFORM_COMPLEMENT) {
+            original = 7 - original;
+        }
+
+        int cell = (rule >> original) & 1;
+        if (transform & ECA_TRANSFORM_COMPLEMENT) {
+            cell = !cell;
+        }
+
+        result |= cell << neighbourhood;
+    }
+
+    return result;
+}
+
+int eca_canonical_rule(int rule, int *transform) {
+
+    int best = rule, best_transform = ECA_TRANSFORM_IDENTITY;
+
+    for (int t = 1; t < ECA_TRANSFORMS_NUM; t++) {
+
+        int transformed = eca_transform_rule(rule, t);
+        if (transformed < best) {
+            best = transformed;
+            best_transform = t;
+        }
+    }
+
+    if (transform != NULL) {
+        *transform = best_transform;
+    }
+
+    return best;
+}
+
+void eca_transform_row(const unsigned char *row, unsigned char *result, int columns_num,
+                       int transform) {
+
+    for (int i = 0; i < columns_num; i++) {
+
+        int cell =
+            (transform & ECA_TRANSFORM_MIRROR) ? row[columns_num - 1 - i] : row[i];
+        result[i] = (transform & ECA_TRANSFORM_COMPLEMENT) ? !cell : cell;
+    }
+}
+
+int eca_least_rotation(const unsigned char *row, int columns_num) {
+
+    // two candidate shifts are compared cell by cell, on a mismatch the larger
+    // one and all shifts within the compared part are skipped
+    int i = 0, j = 1, k = 0;
+
+    while (i < columns_num && j < columns_num && k < columns_num) {
+
+        int a = row[(i + k) % columns_num];
+        int b = row[(j + k) % columns_num];
+
+        if (a == b) {
+            k++;
+            continue;
+        }
+
+        if (a > b) {
+            i += k + 1;
+        } else {
+            j += k + 1;
+        }
+
+        if (i == j) {
+            j++;
+        }
+        k = 0;
+    }
+
+    return (i < j) ? i : j;
+}
+
+void eca_rotate_row(const unsigned char *row, unsigned char *result, int columns_num,
+                    int shift) {
+
+    for (int i = 0; i < columns_num; i++) {
+        result[i] = row[(i + shift) % columns_num];
+    }
+}
+
+const char *eca_transform_name(int transform) {
+
+    static const char *const names[ECA_TRANSFORMS_NUM] = {"identity", "mirror",
+                                                      "complement",
+                                                      "mirror+complement"};
+
+    return names[transform & 3];
+}
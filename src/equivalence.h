@@ -0,0 +1,53 @@
+// Elementary Cellular Automaton - rule equivalence classes
+// Szymon Golebiowski
+
+#ifndef ECA_EQUIVALENCE_H
+#define ECA_EQUIVALENCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The 256 rules fall into 88 classes under reflection and complement. If the
+// rule S is the transform T of the rule R, then running S on T(row) gives T of
+// every row produced by R from row, so one simulation serves the whole class.
+// Rules also commute with rotations of the ring, which lets equal rows up to a
+// rotation share a result.
+#define ECA_RULE_CLASSES_NUM 88
+
+enum eca_rule_transform {
+    ECA_TRANSFORM_IDENTITY = 0,
+    ECA_TRANSFORM_MIRROR = 1,            // left and right swapped
+    ECA_TRANSFORM_COMPLEMENT = 2,        // 0 and 1 swapped
+    ECA_TRANSFORM_MIRROR_COMPLEMENT = 3, // both of them
+};
+
+#define ECA_TRANSFORMS_NUM 4
+
+// the rule which acts on transformed rows like the given rule on the original
+// ones, every transform is its own inverse
+int eca_transform_rule(int rule, int transform);
+
+// the smallest rule of the class, the transform leading to it is stored if
+// transform is not NULL
+int eca_canonical_rule(int rule, int *transform);
+
+// transform the row (result must not overlap it)
+void eca_transform_row(const unsigned char *row, unsigned char *result, int columns_num,
+                       int transform);
+
+// the shift s for which the row rotated left by s cells is the smallest one
+// in the lexicographic order, linear in the width
+int eca_least_rotation(const unsigned char *row, int columns_num);
+
+// rotate the row left by the given number of cells (result must not overlap it)
+void eca_rotate_row(const unsigned char *row, unsigned char *result, int columns_num,
+                    int shift);
+
+const char *eca_transform_name(int transform);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,806 @@
+// Elementary Cellular Automaton - image export
+// Szymon Golebiowski
+
+#include "export.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the largest block of data which deflate can store without compression
+#define MAX_STORED_BLOCK 65535
+
+struct eca_exporter {
+
+    struct eca_writer *writer;
+    enum eca_export_format format;
+    int error;
+
+    int columns_num;
+    int rows_num;
+    int rows_written;
+
+    // every pixel is the average of a square block of scale x scale cells
+    int scale;
+    int width;
+    int height;
+
+    // live cells counted in the current band of rows, a block may hold more
+    // cells than an int can count
+    unsigned long long *sums;
+    int band_rows;
+
+    int bit_depth;
+    int row_bytes;
+    unsigned char *pixels; // one row of the image, preceded by the PNG filter
+    unsigned char *chunk;  // data of the IDAT chunk of one PNG row
+
+    // PNG stream state
+    unsigned int crc_table[256];
+    unsigned int adler_a;
+    unsigned int adler_b;
+    int zlib_started;
+};
+
+int eca_parse_export_format(const char *path) {
+
+    const char *extension = strrchr(path, '.');
+    if (extension == NULL) {
+        return -1;
+    }
+
+    if (strcmp(extension, ".png") == 0) {
+        return ECA_EXPORT_PNG;
+    }
+
+    if (strcmp(extension, ".pbm") == 0) {
+        return ECA_EXPORT_PBM;
+    }
+
+    if (strcmp(extension, ".raw") == 0 || strcmp(extension, ".gray") == 0) {
+        return ECA_EXPORT_RAW;
+    }
+
+    return -1;
+}
+
+static void output(struct eca_exporter *exporter, const void *data, size_t size) {
+
+    if (!exporter->error && size > 0) {
+        exporter->error = eca_writer_write(exporter->writer, data, size);
+    }
+}
+
+static void put_uint32(unsigned char *buffer, unsigned int value) {
+
+    buffer[0] = value >> 24;
+    buffer[1] = value >> 16;
+    buffer[2] = value >> 8;
+    buffer[3] = value;
+}
+
+static unsigned int update_crc(const struct eca_exporter *exporter, unsigned int crc,
+                               const unsigned char *data, size_t size) {
+
+    for (size_t i = 0; i < size; i++) {
+        crc = exporter->crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static void update_adler(struct eca_exporter *exporter, const unsigned char *data,
+                         size_t size) {
+
+    for (size_t i = 0; i < size; i++) {
+        exporter->adler_a = (exporter->adler_a + data[i]) % 65521;
+        exporter->adler_b = (exporter->adler_b + exporter->adler_a) % 65521;
+    }
+}
+
+static void init_crc_table(struct eca_exporter *exporter) {
+
+    for (unsigned int i = 0; i < 256; i++) {
+
+        unsigned int crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 1) ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+        }
+
+        exporter->crc_table[i] = crc;
+    }
+}
+
+// write a PNG chunk made of two parts, so that the data of a chunk does not
+// have to be copied into one buffer
+static void write_chunk(struct eca_exporter *exporter, const char *type,
+                        const unsigned char *head, size_t head_size,
+                        const unsigned char *data, size_t data_size) {
+
+    unsigned char buffer[4];
+
+    put_uint32(buffer, (unsigned int)(head_size + data_size));
+    output(exporter, buffer, 4);
+    output(exporter, type, 4);
+    output(exporter, head, head_size);
+    output(exporter, data, data_size);
+
+    unsigned int crc = update_crc(exporter, 0xffffffffu, (const unsigned char *)type, 4);
+    crc = update_crc(exporter, crc, head, head_size);
+    crc = update_crc(exporter, crc, data, data_size);
+
+    put_uint32(buffer, crc ^ 0xffffffffu);
+    output(exporter, buffer, 4);
+}
+
+static void write_png_header(struct eca_exporter *exporter) {
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    output(exporter, signature, 8);
+
+    // width, height, bit depth, grayscale, deflate, no filtering, no interlace
+    unsigned char header[13];
+    put_uint32(header, exporter->width);
+    put_uint32(header + 4, exporter->height);
+    header[8] = exporter->bit_depth;
+    header[9] = 0;
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    write_chunk(exporter, "IHDR", header, 13, NULL, 0);
+}
+
+// every image row goes into its own IDAT chunk as uncompressed deflate blocks
+static void write_png_row(struct eca_exporter *exporter) {
+
+    size_t size = exporter->row_bytes + 1;
+    unsigned char *chunk = exporter->chunk;
+    size_t length = 0;
+
+    // zlib header, deflate with the default window and no dictionary
+    if (!exporter->zlib_started) {
+        chunk[length++] = 0x78;
+        chunk[length++] = 0x01;
+        exporter->zlib_started = 1;
+    }
+
+    for (size_t offset = 0; offset < size; offset += MAX_STORED_BLOCK) {
+
+        size_t block = size - offset;
+        if (block > MAX_STORED_BLOCK) {
+            block = MAX_STORED_BLOCK;
+        }
+
+        chunk[length++] = 0x00;
+        chunk[length++] = block & 0xff;
+        chunk[length++] = block >> 8;
+        chunk[length++] = ~block & 0xff;
+        chunk[length++] = (~block >> 8) & 0xff;
+
+        memcpy(&chunk[length], &exporter->pixels[offset], block);
+        length += block;
+    }
+
+    update_adler(exporter, exporter->pixels, size);
+    write_chunk(exporter, "IDAT", chunk, length, NULL, 0);
+}
+
+static void write_png_trailer(struct eca_exporter *exporter) {
+
+    // an empty final block closes the deflate stream
+    unsigned char trailer[5] = {0x01, 0x00, 0x00, 0xff, 0xff};
+    unsigned char checksum[4];
+    put_uint32(checksum, (exporter->adler_b << 16) | exporter->adler_a);
+
+    write_chunk(exporter, "IDAT", trailer, 5, checksum, 4);
+    write_chunk(exporter, "IEND", NULL, 0, NULL, 0);
+}
+
+// The layout of a PNG file follows from the size of the image: the signature
+// and the IHDR chunk take 33 bytes, then every row has its own IDAT chunk, the
+// first one preceded by the zlib header, and the file ends with the IDAT chunk
+// of the final block and the Adler-32 checksum and the IEND chunk.
+
+#define PNG_ROWS_OFFSET 33
+#define PNG_TRAILER_SIZE 33
+
+// size of the uncompressed row, with its filter byte, in the deflate stream
+static size_t png_row_size(const struct eca_exporter *exporter) {
+    return (size_t)exporter->row_bytes + 1;
+}
+
+// size of the data of the IDAT chunk of the given row
+static size_t png_chunk_size(const struct eca_exporter *exporter, int row) {
+
+    size_t size = png_row_size(exporter);
+    size_t blocks = (size + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK;
+
+    return (row == 0 ? 2 : 0) + size + 5 * blocks;
+}
+
+static off_t png_chunk_offset(const struct eca_exporter *exporter, int row) {
+
+    // every chunk adds its length, its type and its CRC to the data
+    return PNG_ROWS_OFFSET + (row > 0 ? 2 : 0) +
+           (off_t)row * (png_chunk_size(exporter, 1) + 12);
+}
+
+static off_t png_file_size(const struct eca_exporter *exporter) {
+    return png_chunk_offset(exporter, exporter->height) + PNG_TRAILER_SIZE;
+}
+
+// position of the given byte of pixels of a row in the data of its chunk, the
+// row is preceded by its filter byte and split into blocks with 5-byte headers
+static size_t png_data_position(int row, int byte) {
+
+    size_t position = (size_t)byte + 1;
+    return (row == 0 ? 2 : 0) + 5 * (position / MAX_STORED_BLOCK + 1) + position;
+}
+
+// choose the block size and the size of the image
+static void set_geometry(struct eca_exporter *exporter, int max_width, int max_height) {
+
+    int columns_num = exporter->columns_num;
+    int rows_num = exporter->rows_num;
+    enum eca_export_format format = exporter->format;
+
+    // the smallest block size which fits the diagram in the resolution
+    exporter->scale = 1;
+    if (max_width > 0 && (columns_num + max_width - 1) / max_width > exporter->scale) {
+        exporter->scale = (columns_num + max_width - 1) / max_width;
+    }
+    if (max_height > 0 && (rows_num + max_height - 1) / max_height > exporter->scale) {
+        exporter->scale = (rows_num + max_height - 1) / max_height;
+    }
+
+    exporter->width = (columns_num + exporter->scale - 1) / exporter->scale;
+    exporter->height = (rows_num + exporter->scale - 1) / exporter->scale;
+
+    // averaged pixels are kept gray wherever the format allows it
+    if (format == ECA_EXPORT_RAW || (format == ECA_EXPORT_PNG && exporter->scale > 1)) {
+        exporter->bit_depth = 8;
+        exporter->row_bytes = exporter->width;
+    } else {
+        exporter->bit_depth = 1;
+        exporter->row_bytes = (exporter->width + 7) / 8;
+    }
+}
+
+static void free_exporter(struct eca_exporter *exporter) {
+
+    free(exporter->sums);
+    free(exporter->pixels);
+    free(exporter->chunk);
+    free(exporter);
+}
+
+struct eca_exporter *eca_exporter_create(struct eca_writer *writer,
+                                         enum eca_export_format format,
+                                         int columns_num, int rows_num, int max_width,
+                                         int max_height) {
+
+    struct eca_exporter *exporter =
+        (struct eca_exporter *)calloc(1, sizeof(struct eca_exporter));
+    if (exporter == NULL) {
+        return NULL;
+    }
+
+    exporter->writer = writer;
+    exporter->format = format;
+    exporter->columns_num = columns_num;
+    exporter->rows_num = rows_num;
+
+    set_geometry(exporter, max_width, max_height);
+    exporter->sums = (unsigned long long *)calloc(exporter->width,
+                                                  sizeof(unsigned long long));
+    exporter->pixels = (unsigned char *)calloc(exporter->row_bytes + 1, 1);
+    if (format == ECA_EXPORT_PNG) {
+        exporter->chunk = (unsigned char *)malloc(png_chunk_size(exporter, 0));
+    }
+
+    if (exporter->sums == NULL || exporter->pixels == NULL ||
+        (format == ECA_EXPORT_PNG && exporter->chunk == NULL)) {
+        free_exporter(exporter);
+        return NULL;
+    }
+
+    init_crc_table(exporter);
+    exporter->adler_a = 1;
+    exporter->adler_b = 0;
+
+    if (format == ECA_EXPORT_PNG) {
+        write_png_header(exporter);
+    } else if (format == ECA_EXPORT_PBM) {
+        char header[32];
+        int length =
+            snprintf(header, sizeof(header), "P4\n%d %d\n", exporter->width, exporter->height);
+        output(exporter, header, length);
+    }
+
+    return exporter;
+}
+
+int eca_exporter_width(const struct eca_exporter *exporter) { return exporter->width; }
+
+int eca_exporter_height(const struct eca_exporter *exporter) {
+    return exporter->height;
+}
+
+// the blocks at the right and the bottom edge may be smaller
+static int block_size(int cells_num, int scale, int block) {
+
+    int size = cells_num - block * scale;
+    return (size > scale) ? scale : size;
+}
+
+// set the pixel of the given number of live cells out of all cells of a block,
+// the bits of a 1-bit row have to be cleared beforehand
+static void set_pixel(const struct eca_exporter *exporter, unsigned char *pixels, int x,
+                      unsigned long long live, unsigned long long cells) {
+
+    // live cells are black on a white background
+    if (exporter->bit_depth == 8) {
+        pixels[x] = 255 - (255 * live + cells / 2) / cells;
+    } else {
+
+        int black = 2 * live >= cells;
+        int bit = (exporter->format == ECA_EXPORT_PBM) ? black : !black;
+        pixels[x / 8] |= bit << (7 - x % 8);
+    }
+}
+
+// turn the current band into a row of pixels and write it
+static void flush_band(struct eca_exporter *exporter) {
+
+    unsigned char *pixels = &exporter->pixels[1];
+    memset(pixels, 0, exporter->row_bytes);
+
+    for (int x = 0; x < exporter->width; x++) {
+
+        int block_width = block_size(exporter->columns_num, exporter->scale, x);
+        set_pixel(exporter, pixels, x, exporter->sums[x],
+                  (unsigned long long)block_width * exporter->band_rows);
+    }
+
+    if (exporter->format == ECA_EXPORT_PNG) {
+        write_png_row(exporter);
+    } else {
+        output(exporter, pixels, exporter->row_bytes);
+    }
+
+    memset(exporter->sums, 0, exporter->width * sizeof(unsigned long long));
+    exporter->band_rows = 0;
+}
+
+int eca_exporter_write_row(struct eca_exporter *exporter, const unsigned char *row) {
+
+    if (exporter->rows_written == exporter->rows_num) {
+        return 1;
+    }
+
+    int j = 0;
+    for (int x = 0; x < exporter->width; x++) {
+
+        int block_end = j + exporter->scale;
+        if (block_end > exporter->columns_num) {
+            block_end = exporter->columns_num;
+        }
+
+        unsigned long long live = 0;
+        for (; j < block_end; j++) {
+            live += row[j];
+        }
+
+        exporter->sums[x] += live;
+    }
+
+    exporter->band_rows++;
+    exporter->rows_written++;
+
+    if (exporter->band_rows == exporter->scale ||
+        exporter->rows_written == exporter->rows_num) {
+        flush_band(exporter);
+    }
+
+    return exporter->error;
+}
+
+int eca_exporter_close(struct eca_exporter *exporter) {
+
+    int error = exporter->rows_written != exporter->rows_num;
+
+    if (!error && exporter->format == ECA_EXPORT_PNG) {
+        write_png_trailer(exporter);
+    }
+
+    error |= exporter->error;
+    free_exporter(exporter);
+
+    return error;
+}
+
+// mark the bytes of a row of pixels covering the cells [begin, end)
+static void mark_bytes(const struct eca_exporter *exporter, unsigned char *marks,
+                       int begin, int end) {
+
+    int pixels_per_byte = (exporter->bit_depth == 8) ? 1 : 8;
+    int first = begin / exporter->scale / pixels_per_byte;
+    int last = (end - 1) / exporter->scale / pixels_per_byte;
+
+    memset(&marks[first], 1, last - first + 1);
+}
+
+// calculate the pixels of the bytes [first, last] of the given band
+static void calculate_bytes(const struct eca_exporter *exporter,
+                            const struct eca_history *history, int band, int first,
+                            int last) {
+
+    int pixels_per_byte = (exporter->bit_depth == 8) ? 1 : 8;
+    int x_end = (last + 1) * pixels_per_byte;
+    if (x_end > exporter->width) {
+        x_end = exporter->width;
+    }
+
+    int scale = exporter->scale;
+    int band_rows = block_size(exporter->rows_num, scale, band);
+    memset(&exporter->pixels[first], 0, last - first + 1);
+
+    for (int x = first * pixels_per_byte; x < x_end; x++) {
+
+        int block_width = block_size(exporter->columns_num, scale, x);
+        unsigned long long live = 0;
+
+        for (int i = 0; i < band_rows; i++) {
+
+            const unsigned char *row = eca_history_row(history, band * scale + i);
+            for (int j = 0; j < block_width; j++) {
+                live += row[x * scale + j];
+            }
+        }
+
+        set_pixel(exporter, exporter->pixels, x, live,
+                  (unsigned long long)block_width * band_rows);
+    }
+}
+
+static int write_at(int fd, const void *data, size_t size, off_t position) {
+    return pwrite(fd, data, size, position) != (ssize_t)size;
+}
+
+// replace the bytes [first, last] of a row in the data of its IDAT chunk read
+// before and write them, a byte of the deflate stream of length L changed by d
+// at position p changes the sums of Adler-32 by d and d * (L - p)
+static int patch_png_bytes(const struct eca_exporter *exporter, unsigned char *chunk,
+                           int fd, int band, int first, int last,
+                           unsigned long long adler[2]) {
+
+    unsigned long long length = (unsigned long long)exporter->height *
+                                png_row_size(exporter);
+
+    for (int byte = first; byte <= last; byte++) {
+
+        unsigned char *old = &chunk[png_data_position(band, byte)];
+        unsigned long long position =
+            (unsigned long long)band * png_row_size(exporter) + 1 + byte;
+        unsigned long long change = (exporter->pixels[byte] + 65521ULL - *old) % 65521;
+
+        adler[0] = (adler[0] + change) % 65521;
+        adler[1] = (adler[1] + change * ((length - position) % 65521)) % 65521;
+        *old = exporter->pixels[byte];
+    }
+
+    // the block headers between the bytes are written back unchanged
+    size_t begin = png_data_position(band, first);
+    size_t end = png_data_position(band, last) + 1;
+
+    return write_at(fd, &chunk[begin], end - begin,
+                    png_chunk_offset(exporter, band) + 8 + begin);
+}
+
+// write the CRC of a chunk whose data is at the given offset
+static int write_crc(const struct eca_exporter *exporter, int fd, off_t offset,
+                     const unsigned char *data, size_t size) {
+
+    unsigned int crc =
+        update_crc(exporter, 0xffffffffu, (const unsigned char *)"IDAT", 4);
+    crc = update_crc(exporter, crc, data, size);
+
+    unsigned char buffer[4];
+    put_uint32(buffer, crc ^ 0xffffffffu);
+
+    return write_at(fd, buffer, 4, offset + size);
+}
+
+// add the changes of the Adler-32 sums to the checksum in the last IDAT chunk
+static int patch_png_checksum(const struct eca_exporter *exporter, int fd,
+                              const unsigned long long adler[2]) {
+
+    off_t offset = png_chunk_offset(exporter, exporter->height) + 8;
+    unsigned char data[9];
+
+    if (pread(fd, data, 9, offset) != 9) {
+        return 1;
+    }
+
+    unsigned int a = ((data[7] << 8) | data[8]) % 65521;
+    unsigned int b = ((data[5] << 8) | data[6]) % 65521;
+    a = (a + adler[0]) % 65521;
+    b = (b + adler[1]) % 65521;
+    put_uint32(&data[5], (b << 16) | a);
+
+    return write_at(fd, &data[5], 4, offset + 5) ||
+           write_crc(exporter, fd, offset, data, 9);
+}
+
+int eca_export_patch(const char *path, enum eca_export_format format,
+                     const struct eca_history *history, int max_width, int max_height,
+                     unsigned long long *bytes) {
+
+    *bytes = 0;
+
+    struct eca_exporter exporter;
+    memset(&exporter, 0, sizeof(exporter));
+    exporter.format = format;
+    exporter.columns_num = eca_history_columns_num(history);
+    exporter.rows_num = eca_history_rows_num(history);
+    set_geometry(&exporter, max_width, max_height);
+    init_crc_table(&exporter);
+
+    char header[32] = "";
+    if (format == ECA_EXPORT_PBM) {
+        snprintf(header, sizeof(header), "P4\n%d %d\n", exporter.width,
+                 exporter.height);
+    }
+    off_t offset = (off_t)strlen(header);
+
+    off_t file_size = (format == ECA_EXPORT_PNG)
+                          ? png_file_size(&exporter)
+                          : offset + (off_t)exporter.height * exporter.row_bytes;
+
+    // the file has to be an image of the same size, PNG chunks are read to
+    // update their checksums
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return 1;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size != file_size) {
+        close(fd);
+        return 1;
+    }
+
+    exporter.pixels = (unsigned char *)malloc(exporter.row_bytes);
+    unsigned char *marks = (unsigned char *)calloc(exporter.row_bytes, 1);
+    unsigned char *chunk = NULL;
+    if (format == ECA_EXPORT_PNG) {
+        chunk = (unsigned char *)malloc(png_chunk_size(&exporter, 0));
+    }
+
+    const struct eca_span *dirty = eca_history_dirty(history);
+    int columns_num = exporter.columns_num;
+    unsigned long long adler[2] = {0, 0};
+    int error = exporter.pixels == NULL || marks == NULL ||
+                (format == ECA_EXPORT_PNG && chunk == NULL);
+
+    for (int band = 0; band < exporter.height && !error; band++) {
+
+        int band_rows = block_size(exporter.rows_num, exporter.scale, band);
+        int changed = 0;
+
+        for (int i = 0; i < band_rows; i++) {
+
+            const struct eca_span *span = &dirty[band * exporter.scale + i];
+            if (span->length == 0) {
+                continue;
+            }
+
+            // a span wrapping around the ring covers both of its ends
+            int end = span->begin + span->length;
+            if (end > columns_num) {
+                mark_bytes(&exporter, marks, span->begin, columns_num);
+                mark_bytes(&exporter, marks, 0, end - columns_num);
+            } else {
+                mark_bytes(&exporter, marks, span->begin, end);
+            }
+
+            changed = 1;
+        }
+
+        if (!changed) {
+            continue;
+        }
+
+        size_t chunk_size = png_chunk_size(&exporter, band);
+        off_t chunk_offset = png_chunk_offset(&exporter, band) + 8;
+        if (chunk != NULL && pread(fd, chunk, chunk_size, chunk_offset) !=
+                                 (ssize_t)chunk_size) {
+            error = 1;
+            break;
+        }
+
+        // every run of marked bytes is written at once
+        for (int first = 0; first < exporter.row_bytes && !error; first++) {
+
+            if (!marks[first]) {
+                continue;
+            }
+
+            int last = first;
+            while (last + 1 < exporter.row_bytes && marks[last + 1]) {
+                last++;
+            }
+
+            calculate_bytes(&exporter, history, band, first, last);
+
+            if (chunk != NULL) {
+                error = patch_png_bytes(&exporter, chunk, fd, band, first, last, adler);
+            } else {
+                error = write_at(fd, &exporter.pixels[first], last - first + 1,
+                                 offset + (off_t)band * exporter.row_bytes + first);
+            }
+
+            *bytes += last - first + 1;
+            first = last;
+        }
+
+        if (chunk != NULL && !error) {
+            error = write_crc(&exporter, fd, chunk_offset, chunk, chunk_size);
+        }
+
+        memset(marks, 0, exporter.row_bytes);
+    }
+
+    if (chunk != NULL && !error) {
+        error = patch_png_checksum(&exporter, fd, adler);
+    }
+
+    error |= close(fd) != 0;
+
+    free(exporter.pixels);
+    free(marks);
+    free(chunk);
+
+    return error;
+}
+
+#define FIRST_ROW_MAGIC "ECAFIRST"
+#define FIRST_ROW_VERSION 1
+
+// the file path.row starts with the parameters of the diagram and the state of
+// the image written from it, followed by the first row packed into bits
+struct first_row_header {
+
+    char magic[8];
+    int version;
+    int rule;
+    int columns_num;
+    int rows_num;
+    int max_width;
+    int max_height;
+    long long image_size;
+    long long image_seconds; // modification time of the image
+    long long image_nanoseconds;
+};
+
+static char *first_row_path(const char *path) {
+
+    char *row_path = (char *)malloc(strlen(path) + 5);
+    if (row_path != NULL) {
+        sprintf(row_path, "%s.row", path);
+    }
+
+    return row_path;
+}
+
+// describe the current state of the image, returns 0 on success
+static int fill_first_row_header(struct first_row_header *header, const char *path,
+                                 const struct eca_config *config, int rows_num,
+                                 int max_width, int max_height) {
+
+    struct stat status;
+    if (stat(path, &status) != 0) {
+        return 1;
+    }
+
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, FIRST_ROW_MAGIC, 8);
+    header->version = FIRST_ROW_VERSION;
+    header->rule = config->rule;
+    header->columns_num = config->columns_num;
+    header->rows_num = rows_num;
+    header->max_width = max_width;
+    header->max_height = max_height;
+    header->image_size = status.st_size;
+    header->image_seconds = status.st_mtim.tv_sec;
+    header->image_nanoseconds = status.st_mtim.tv_nsec;
+
+    return 0;
+}
+
+int eca_export_save_first_row(const char *path, const struct eca_config *config,
+                              int rows_num, int max_width, int max_height,
+                              const unsigned char *row) {
+
+    struct first_row_header header;
+    if (fill_first_row_header(&header, path, config, rows_num, max_width,
+                              max_height) != 0) {
+        return 1;
+    }
+
+    char *row_path = first_row_path(path);
+    char *temporary_path = (char *)malloc(strlen(path) + 32);
+    int packed_size = (config->columns_num + 7) / 8;
+    unsigned char *packed = (unsigned char *)malloc(packed_size);
+
+    if (row_path == NULL || temporary_path == NULL || packed == NULL) {
+        free(row_path);
+        free(temporary_path);
+        free(packed);
+        return 1;
+    }
+
+    eca_pack_row(row, packed, config->columns_num);
+
+    // the file is replaced at once, so that it never holds a partial row
+    sprintf(temporary_path, "%s.row.%d.tmp", path, (int)getpid());
+
+    int error = 1;
+    FILE *file = fopen(temporary_path, "wb");
+    if (file != NULL) {
+
+        error = fwrite(&header, sizeof(header), 1, file) != 1 ||
+                fwrite(packed, packed_size, 1, file) != 1;
+        error |= fclose(file) != 0;
+        error = error || rename(temporary_path, row_path) != 0;
+
+        if (error) {
+            unlink(temporary_path);
+        }
+    }
+
+    free(row_path);
+    free(temporary_path);
+    free(packed);
+
+    return error;
+}
+
+int eca_export_load_first_row(const char *path, const struct eca_config *config,
+                              int rows_num, int max_width, int max_height,
+                              unsigned char *row) {
+
+    struct first_row_header expected;
+    if (fill_first_row_header(&expected, path, config, rows_num, max_width,
+                              max_height) != 0) {
+        return 1;
+    }
+
+    char *row_path = first_row_path(path);
+    FILE *file = row_path != NULL ? fopen(row_path, "rb") : NULL;
+    free(row_path);
+
+    if (file == NULL) {
+        return 1;
+    }
+
+    int packed_size = (config->columns_num + 7) / 8;
+    unsigned char *packed = (unsigned char *)malloc(packed_size);
+
+    struct first_row_header header;
+    int error = packed == NULL || fread(&header, sizeof(header), 1, file) != 1 ||
+                memcmp(&header, &expected, sizeof(header)) != 0 ||
+                fread(packed, packed_size, 1, file) != 1;
+
+    if (!error) {
+        eca_unpack_row(packed, row, config->columns_num);
+    }
+
+    free(packed);
+    fclose(file);
+
+    return error;
+}
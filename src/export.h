@@ -0,0 +1,75 @@
+// Elementary Cellular Automaton - image export
+// Szymon Golebiowski
+
+#ifndef ECA_EXPORT_H
+#define ECA_EXPORT_H
+
+#include "eca.h"
+#include "writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum eca_export_format {
+    ECA_EXPORT_PNG, // grayscale, 1-bit or 8-bit if downsampled
+    ECA_EXPORT_PBM, // binary portable bitmap
+    ECA_EXPORT_RAW, // 8-bit gray pixels only, for ffmpeg -f rawvideo -pix_fmt gray
+};
+
+// rows of the space-time diagram are streamed into the file one by one, when
+// the diagram is larger than the maximum resolution it is downsampled by
+// averaging square blocks of cells, only one band of rows is kept in memory
+struct eca_exporter;
+
+// choose the format by the extension of the file name, returns -1 if unknown
+int eca_parse_export_format(const char *path);
+
+// create an exporter of a diagram of rows_num rows and columns_num columns
+// which writes the image into the given writer, max_width and max_height
+// equal to 0 mean no limit, returns NULL when out of memory
+struct eca_exporter *eca_exporter_create(struct eca_writer *writer,
+                                         enum eca_export_format format,
+                                         int columns_num, int rows_num, int max_width,
+                                         int max_height);
+
+// size of the exported image in pixels
+int eca_exporter_width(const struct eca_exporter *exporter);
+int eca_exporter_height(const struct eca_exporter *exporter);
+
+// append the next row of cells, returns 0 on success
+int eca_exporter_write_row(struct eca_exporter *exporter, const unsigned char *row);
+
+// finish the image and free the exporter, the writer stays open
+// returns 0 on success
+int eca_exporter_close(struct eca_exporter *exporter);
+
+// rewrite only the pixels of the cells changed by the last update of the
+// history in an image exported before with the same resolution limits from the
+// first row the history had before the update (see eca_export_load_first_row), the
+// number of written bytes is stored, in PNG images the checksums of the changed
+// rows and of the whole stream are updated too, returns 0 on success
+int eca_export_patch(const char *path, enum eca_export_format format,
+                     const struct eca_history *history, int max_width, int max_height,
+                     unsigned long long *bytes);
+
+// store the first row of the diagram in the file path.row next to the image,
+// together with the rule, the size of the diagram, the resolution limits and
+// the size and modification time of the image, it has to be stored again
+// after every patch, returns 0 on success
+int eca_export_save_first_row(const char *path, const struct eca_config *config,
+                              int rows_num, int max_width, int max_height,
+                              const unsigned char *row);
+
+// read the first row of columns_num cells stored next to the image, returns 0
+// only if it has been stored for the same parameters and the image has not
+// been modified since then, so that a patch can be based on it
+int eca_export_load_first_row(const char *path, const struct eca_config *config,
+                              int rows_num, int max_width, int max_height,
+                              unsigned char *row);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,12 +2,23 @@
 // Szymon Golebiowski
 
 #include "argparse.h" // https://github.com/Cofyc/argparse
+#include "distributed.h"
+#include "eca.h"
+#include "equivalence.h"
+#include "export.h"
+#include "writer.h"
+#include "preimage.h"
+#include "state_space.h"
+#include "sweep.h"
 #include <allegro5/allegro5.h>
 #include <allegro5/allegro_font.h>
 #include <allegro5/allegro_primitives.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 // CONFIGURATION
 #define CELL_HEIGHT 10
@@ -16,36 +27,63 @@
 #define DEFAULT_COLUMNS_NUM 80
 #define ITERATION_TIME 0.01
 
-// display the given iteration row
-void display_population(int **population, int iteration, int columns_num) {
+// draw the given cells of a row into the diagram bitmap, dead cells are cleared
+void draw_cells(const struct eca_history *history, int row, struct eca_span span) {
 
     ALLEGRO_COLOR cell_color = al_map_rgb(138, 43, 226);
+    ALLEGRO_COLOR background_color = al_map_rgb(0, 0, 0);
 
-    for (int i = 0; i < iteration; i++) {
+    const unsigned char *cells = eca_history_row(history, row);
+    int columns_num = eca_history_columns_num(history);
 
-        // set vertical coordinates
-        int y1 = i * CELL_HEIGHT;
-        int y2 = y1 + CELL_HEIGHT;
+    // set vertical coordinates
+    int y1 = row * CELL_HEIGHT;
+    int y2 = y1 + CELL_HEIGHT;
 
-        for (int j = 0; j < columns_num; j++) {
+    for (int i = 0; i < span.length; i++) {
 
-            // set horizontal coordinates
-            int x1 = j * CELL_WIDTH;
-            int x2 = x1 + CELL_WIDTH;
+        // set horizontal coordinates
+        int j = (span.begin + i) % columns_num;
+        int x1 = j * CELL_WIDTH;
+        int x2 = x1 + CELL_WIDTH;
 
-            if (population[i][j] == 1) {
-                al_draw_filled_rectangle(x1, y1, x2, y2, cell_color);
-            }
-        }
+        al_draw_filled_rectangle(x1, y1, x2, y2,
+                                 cells[j] == 1 ? cell_color : background_color);
+    }
+}
+
+// redraw only the cells changed by the last edit of the first row
+void draw_dirty_cells(ALLEGRO_BITMAP *diagram, ALLEGRO_DISPLAY *disp,
+                      const struct eca_history *history, int rows_changed) {
+
+    const struct eca_span *dirty = eca_history_dirty(history);
+
+    al_set_target_bitmap(diagram);
+    for (int i = 0; i < rows_changed; i++) {
+        draw_cells(history, i, dirty[i]);
     }
+    al_set_target_bitmap(al_get_backbuffer(disp));
 }
 
-// visualize the simulation step by step
-void visualize_simulation(int **population, int iterations_num, int rule,
-                          int population_size, int columns_num) {
+// display the given number of rows of the diagram
+void display_population(ALLEGRO_BITMAP *diagram, int iteration, int columns_num) {
+
+    if (iteration > 0) {
+        al_draw_bitmap_region(diagram, 0, 0, CELL_WIDTH * columns_num,
+                              CELL_HEIGHT * iteration, 0, 0, 0);
+    }
+}
+
+// visualize the simulation step by step, cells of the first row can be flipped
+// by clicking them
+void visualize_simulation(struct eca_history *history, int rule, int population_size) {
+
+    int iterations_num = eca_history_rows_num(history);
+    int columns_num = eca_history_columns_num(history);
 
     al_init();                  // initialize Allegro library
     al_install_keyboard();      // initialize keyboard handling
+    al_install_mouse();         // initialize mouse handling
     al_init_primitives_addon(); // initialize shapes drawing
 
 
@@ -59,11 +97,24 @@ void visualize_simulation(int **population, int iterations_num, int rule,
 
     ALLEGRO_DISPLAY *disp = al_create_display(window_width, window_height);
 
+    // the whole diagram is drawn once, later only the changed cells
+    ALLEGRO_BITMAP *diagram =
+        al_create_bitmap(CELL_WIDTH * columns_num, CELL_HEIGHT * iterations_num);
+    al_set_target_bitmap(diagram);
+    al_clear_to_color(al_map_rgb(0, 0, 0));
+    for (int i = 0; i < iterations_num; i++) {
+        struct eca_span row = {0, columns_num};
+        draw_cells(history, i, row);
+    }
+    al_set_target_bitmap(al_get_backbuffer(disp));
+
     // read a default font
     ALLEGRO_FONT *font = al_create_builtin_font();
 
     al_register_event_source(events_queue, al_get_keyboard_event_source());
 
+    al_register_event_source(events_queue, al_get_mouse_event_source());
+
     al_register_event_source(events_queue, al_get_display_event_source(disp));
 
     al_register_event_source(events_queue, al_get_timer_event_source(timer));
@@ -75,6 +126,8 @@ void visualize_simulation(int **population, int iterations_num, int rule,
 
     double time, previous_time = al_get_time();
     int iteration = 0;
+    int rows_changed = -1;
+    long long cells_calculated = 0;
     char text[100];
 
     while (1) {
@@ -83,6 +136,24 @@ void visualize_simulation(int **population, int iterations_num, int rule,
 
         if (event.type == ALLEGRO_EVENT_TIMER) {
             refresh = 1;
+        } else if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN) {
+
+            int column = event.mouse.x / CELL_WIDTH;
+            int flipped = -1;
+            if (event.mouse.y < CELL_HEIGHT && column < columns_num) {
+                flipped = eca_history_flip(history, column);
+            }
+
+            // the history is left unchanged when the flip fails
+            if (flipped >= 0) {
+
+                rows_changed = flipped;
+                cells_calculated = eca_history_calculated(history);
+                population_size += eca_history_row(history, 0)[column] ? 1 : -1;
+
+                draw_dirty_cells(diagram, disp, history, rows_changed);
+                refresh = 1;
+            }
         } else if ((event.type == ALLEGRO_EVENT_KEY_DOWN) ||
                    (event.type == ALLEGRO_EVENT_DISPLAY_CLOSE)) {
             break;
@@ -114,6 +185,21 @@ void visualize_simulation(int **population, int iterations_num, int rule,
             sprintf(text, "COLUMNS NUMBER: %d", columns_num);
             al_draw_text(font, al_map_rgb(255, 255, 255), x1, y1, 0, text);
 
+            y1 += 20;
+            al_draw_text(font, al_map_rgb(255, 255, 255), x1, y1, 0,
+                         "CLICK ROW 0 TO EDIT");
+
+            if (rows_changed >= 0) {
+
+                y1 += 20;
+                sprintf(text, "CHANGED ROWS: %d", rows_changed);
+                al_draw_text(font, al_map_rgb(255, 255, 255), x1, y1, 0, text);
+
+                y1 += 20;
+                sprintf(text, "CALCULATED CELLS: %lld", cells_calculated);
+                al_draw_text(font, al_map_rgb(255, 255, 255), x1, y1, 0, text);
+            }
+
             if (iteration == iterations_num) {
 
                 x1 = 40;
@@ -123,7 +209,7 @@ void visualize_simulation(int **population, int iterations_num, int rule,
                 al_draw_text(font, al_map_rgb(255, 255, 255), x1, y1, 0, text);
             }
 
-            display_population(population, iteration, columns_num);
+            display_population(diagram, iteration, columns_num);
 
             al_flip_display();
             refresh = 0;
@@ -131,110 +217,362 @@ void visualize_simulation(int **population, int iterations_num, int rule,
     }
 
     // close the window and finalize the Allegro library
+    al_destroy_bitmap(diagram);
     al_destroy_font(font);
     al_destroy_display(disp);
     al_destroy_timer(timer);
     al_destroy_event_queue(events_queue);
 }
 
-// create a random initial population of the given size
-int **create_population(int iterations_num, int population_size, int columns_num) {
+// conduct a simulation with given parameters
+void run_simulation(const struct eca_config *config, int iterations_num) {
 
-    int **population = (int **)malloc(iterations_num * sizeof(int *));
-    for (int i = 0; i < iterations_num; i++) {
+    // all iterations are kept, so that edits recalculate only their light cone
+    struct eca_history *history = eca_history_create(config, iterations_num);
 
-        population[i] = (int *)malloc(columns_num * sizeof(int));
+    visualize_simulation(history, config->rule, config->population_size);
 
-        for (int j = 0; j < columns_num; j++) {
-            population[i][j] = 0;
-        }
+    eca_history_destroy(history);
+}
+
+// conduct a simulation without keeping its history and stream it into a file
+int export_simulation(const struct eca_config *config, int iterations_num,
+                      const char *path, int max_width, int max_height,
+                      int queue_length, int batch_size, int direct) {
+
+    struct eca_writer *writer =
+        eca_writer_create(path, queue_length, (size_t)batch_size << 10, direct);
+    if (writer == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    struct eca_exporter *exporter =
+        eca_exporter_create(writer, eca_parse_export_format(path), config->columns_num,
+                            iterations_num, max_width, max_height);
+    if (exporter == NULL) {
+        fprintf(stderr, "Not enough memory to export %s\n", path);
+        eca_writer_close(writer, NULL);
+        return 1;
     }
 
-    int cell;
-    for (int i = 0; i < population_size; i++) {
+    // only the current iteration is kept, the first row is stored next to the
+    // image for later patches
+    struct eca_context *context = eca_create(config);
+    unsigned char *first_row = (unsigned char *)malloc(config->columns_num);
+    eca_get_row(context, first_row);
+    int error = eca_exporter_write_row(exporter, eca_row(context));
 
-        do {
-            cell = rand() % columns_num;
-        } while (population[0][cell] == 1);
+    for (int iteration = 1; iteration < iterations_num && !error; iteration++) {
 
-        population[0][cell] = 1;
+        eca_step(context, 1);
+        error = eca_exporter_write_row(exporter, eca_row(context));
     }
 
-    return population;
+    printf("%s: %d x %d\n", path, eca_exporter_width(exporter),
+           eca_exporter_height(exporter));
+
+    struct eca_writer_stats stats;
+    error |= eca_exporter_close(exporter);
+    error |= eca_writer_close(writer, &stats);
+    eca_destroy(context);
+
+    if (error) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        free(first_row);
+        return error;
+    }
+
+    error = eca_export_save_first_row(path, config, iterations_num, max_width,
+                                      max_height, first_row);
+    free(first_row);
+
+    if (error) {
+        fprintf(stderr, "Cannot store the first row of %s\n", path);
+        return error;
+    }
+
+    printf("WRITTEN: %llu bytes in %llu batches%s\n", stats.bytes, stats.batches,
+           stats.direct ? " (O_DIRECT)" : "");
+    printf("QUEUE OCCUPANCY: average %.2f, max %d of %d\n", stats.average_occupancy,
+           stats.max_occupancy, stats.queue_length);
+    printf("WRITE BANDWIDTH: %.1f MB/s (%.1f MB/s overall)\n",
+           stats.write_seconds > 0 ? stats.bytes / stats.write_seconds / 1e6 : 0.0,
+           stats.total_seconds > 0 ? stats.bytes / stats.total_seconds / 1e6 : 0.0);
+    printf("SIMULATION STALLED: %.3f s of %.3f s\n", stats.stall_seconds,
+           stats.total_seconds);
+
+    return 0;
 }
 
-// free memory allocated for a population
-void delete_population(int **population, int iterations_num) {
+// flip the given comma separated cells of the first row of a simulation
+// exported before with the same parameters and rewrite only the changed pixels,
+// the first row is the one stored next to the image by the last export or patch
+int patch_simulation(const struct eca_config *config, int iterations_num,
+                     const char *path, int max_width, int max_height,
+                     const char *flips) {
 
-    for (int i = 0; i < iterations_num; i++) {
-        free(population[i]);
+    int columns_num = config->columns_num;
+    unsigned char *row = (unsigned char *)malloc(columns_num);
+
+    // the seed may differ from the one of the export and the image may have
+    // been patched since then
+    if (eca_export_load_first_row(path, config, iterations_num, max_width, max_height,
+                                  row) != 0) {
+        fprintf(stderr,
+                "No first row of %s stored for these options or the image has "
+                "changed since, export it again\n",
+                path);
+        free(row);
+        return 1;
+    }
+
+    // the whole diagram is kept to find the pixels covering the changed cells
+    struct eca_history *history =
+        eca_history_create_from_row(config, iterations_num, row);
+    if (history == NULL) {
+        fprintf(stderr, "Not enough memory for %d iterations\n", iterations_num);
+        free(row);
+        return 1;
+    }
+
+    for (const char *flip = flips; *flip != '\0';) {
+
+        char *end;
+        long column = strtol(flip, &end, 10);
+
+        if (end == flip || !(0 <= column && column < columns_num) ||
+            (*end != ',' && *end != '\0')) {
+            fprintf(stderr, "Incorrect cells to flip: %s\n", flips);
+            free(row);
+            eca_history_destroy(history);
+            return 2;
+        }
+
+        row[column] = !row[column];
+        flip = (*end == ',') ? end + 1 : end;
+    }
+
+    int rows_changed = eca_history_set_first_row(history, row);
+    free(row);
+
+    printf("CHANGED ROWS: %d of %d\n", rows_changed, iterations_num);
+    printf("CALCULATED CELLS: %lld of %lld\n", eca_history_calculated(history),
+           (long long)iterations_num * columns_num);
+
+    unsigned long long bytes;
+    int error = eca_export_patch(path, eca_parse_export_format(path), history,
+                                 max_width, max_height, &bytes);
+
+    if (error) {
+        fprintf(stderr, "Cannot patch %s, export it again\n", path);
+    } else {
+
+        printf("PATCHED: %llu bytes of %s\n", bytes, path);
+
+        error = eca_export_save_first_row(path, config, iterations_num, max_width,
+                                          max_height, eca_history_row(history, 0));
+        if (error) {
+            fprintf(stderr, "Cannot store the first row of %s\n", path);
+        }
     }
 
-    free(population);
+    eca_history_destroy(history);
+
+    return error;
 }
 
-// calculate the state of the given cell on the basis of its upper neighbours
-int calculate_cell(int upper_left, int upper_middle, int upper_right, int rule) {
+// count the predecessors of a row and print at most preimages_num of them
+void analyze_preimages(int rule, const unsigned char *row, int columns_num,
+                       int preimages_num) {
+
+    unsigned long long count;
+    int saturated = eca_count_preimages(row, columns_num, rule, &count);
+
+    printf("RULE: %d\nROW: ", rule);
+    for (int j = 0; j < columns_num; j++) {
+        putchar(row[j] ? '1' : '0');
+    }
+
+    printf("\nPREIMAGES: %s%llu\n", saturated ? ">= " : "", count);
+    if (count == 0) {
+        printf("GARDEN OF EDEN\n");
+    }
+
+    struct eca_preimage_enumerator *enumerator =
+        eca_preimage_enumerator_create(row, columns_num, rule);
+    unsigned char *preimage = (unsigned char *)malloc(columns_num);
+
+    for (int i = 0; i < preimages_num; i++) {
+
+        if (!eca_preimage_enumerator_next(enumerator, preimage)) {
+            break;
+        }
+
+        for (int j = 0; j < columns_num; j++) {
+            putchar(preimage[j] ? '1' : '0');
+        }
+        putchar('\n');
+    }
+
+    free(preimage);
+    eca_preimage_enumerator_delete(enumerator);
+}
 
-    int upper_cells_type = 4 * upper_left + 2 * upper_middle + upper_right;
+// explore all states of a ring and print its attractors
+int analyze_ring(int rule, int columns_num, int threads_num) {
 
-    if (rule & (1 << upper_cells_type)) {
+    struct eca_state_space state_space;
+    if (eca_analyze_state_space(rule, columns_num, threads_num, &state_space)) {
+        fprintf(stderr, "Not enough memory for %d columns\n", columns_num);
         return 1;
     }
 
+    printf("RULE: %d\n", rule);
+    printf("COLUMNS NUMBER: %d\n", columns_num);
+    printf("STATES: %llu\n", state_space.states_num);
+    printf("GARDEN OF EDEN STATES: %llu\n", state_space.garden_of_eden_num);
+    printf("RECURRENT STATES: %llu\n", state_space.recurrent_num);
+    printf("LONGEST TRANSIENT: %d\n", state_space.transient_length);
+    printf("ATTRACTORS: %d\n", state_space.attractors_num);
+
+    for (int i = 0; i < state_space.attractors_num; i++) {
+
+        struct eca_attractor *attractor = &state_space.attractors[i];
+
+        printf("    ");
+        for (int j = 0; j < columns_num; j++) {
+            putchar(((attractor->state >> j) & 1) ? '1' : '0');
+        }
+
+        printf("  period %llu, cycles %d, basin %llu\n", attractor->period,
+               attractor->cycles_num, attractor->basin_size);
+    }
+
+    printf("IN-DEGREE DISTRIBUTION:\n");
+    for (int i = 0; i < ECA_IN_DEGREE_BUCKETS; i++) {
+
+        if (state_space.in_degree[i] == 0) {
+            continue;
+        }
+
+        printf("    %s%d: %llu\n", (i == ECA_IN_DEGREE_BUCKETS - 1) ? ">= " : "", i,
+               state_space.in_degree[i]);
+    }
+
+    eca_delete_state_space(&state_space);
+
     return 0;
 }
 
-// calculate the next iteration
-void calculate_iteration(int **population, int iteration, int rule, int columns_num) {
+// run all rules on the same initial row and print a summary of each of them
+int sweep_rules(const struct eca_config *config, int iterations_num,
+                const char *cache_directory) {
+
+    struct eca_sweep_result results[ECA_RULES_NUM];
+    if (eca_run_sweep(config, iterations_num, cache_directory, results)) {
+        fprintf(stderr, "Cannot use the cache directory: %s\n", cache_directory);
+        return 1;
+    }
+
+    printf("COLUMNS NUMBER: %d\n", config->columns_num);
+    printf("ITERATIONS: %d\n", iterations_num);
+    printf("SEED: %llu\n", config->seed);
+    printf("RULE  CLASS  TRANSFORM          POPULATION  CHECKSUM          SOURCE\n");
+
+    int sources[3] = {0, 0, 0};
+    for (int rule = 0; rule < ECA_RULES_NUM; rule++) {
+
+        struct eca_sweep_result *result = &results[rule];
+        sources[result->source]++;
 
-    int upper_left, upper_middle, upper_right;
-    int upper_left_num, upper_middle_num, upper_right_num;
-    int current_cell;
+        printf("%4d  %5d  %-17s  %10llu  %016llx  %s\n", rule,
+               result->representative, eca_transform_name(result->transform),
+               result->population, result->checksum,
+               eca_sweep_source_name(result->source));
+    }
 
-    for (int cell_num = 0; cell_num < columns_num; cell_num++) {
+    printf("SIMULATIONS: %d computed, %d read from the cache, %d rules derived "
+           "from them\n",
+           sources[ECA_SWEEP_COMPUTED], sources[ECA_SWEEP_CACHED],
+           sources[ECA_SWEEP_DERIVED]);
 
-        upper_left_num = (cell_num - 1 + columns_num) % columns_num;
-        upper_middle_num = cell_num;
-        upper_right_num = (cell_num + 1) % columns_num;
+    return 0;
+}
 
-        upper_left = population[iteration - 1][upper_left_num];
-        upper_middle = population[iteration - 1][upper_middle_num];
-        upper_right = population[iteration - 1][upper_right_num];
+// simulate one slice of the ring in the calling process
+int run_slice(struct eca_transport *transport, void *arg) {
 
-        current_cell = calculate_cell(upper_left, upper_middle, upper_right, rule);
+    const struct eca_distributed_config *config =
+        (const struct eca_distributed_config *)arg;
+    struct eca_distributed_result result;
 
-        population[iteration][cell_num] = current_cell;
+    if (eca_run_distributed(transport, config, &result)) {
+        fprintf(stderr, "Process %d failed\n", transport->rank);
+        return 1;
     }
+
+    if (transport->rank == 0) {
+        printf("RULE: %d\n", config->rule);
+        printf("COLUMNS NUMBER: %lld\n", config->columns_num);
+        printf("ITERATIONS: %lld\n", config->iterations_num);
+        printf("PROCESSES: %d\n", transport->processes_num);
+        printf("SEED: %llu\n", config->seed);
+        printf("POPULATION SIZE: %llu\n", result.population);
+        printf("CHECKSUM: %016llx\n", result.checksum);
+    }
+
+    return 0;
 }
 
-// conduct a simulation with given parameters
-void run_simulation(int rule, int population_size, int iterations_num,
-                    int columns_num) {
+// conduct a simulation split among several processes
+int run_distributed_simulation(const struct eca_distributed_config *config,
+                               int transport_type, int processes_num) {
 
-    int **population =
-        create_population(iterations_num, population_size, columns_num);
+#ifdef ECA_HAVE_MPI
+    if (transport_type == ECA_TRANSPORT_MPI) {
 
-    for (int iteration = 1; iteration < iterations_num; iteration++) {
+        struct eca_transport *transport = eca_create_mpi_transport(NULL, NULL);
+        int status = run_slice(transport, (void *)config);
+        transport->destroy(transport);
 
-        calculate_iteration(population, iteration, rule, columns_num);
+        return status;
     }
+#endif
 
-    visualize_simulation(population, iterations_num, rule, population_size,
-                         columns_num);
+    if (transport_type == ECA_TRANSPORT_MPI) {
+        fprintf(stderr, "MPI transport is not available in this build\n");
+        return 1;
+    }
 
-    delete_population(population, iterations_num);
+    return eca_launch_local_processes(transport_type, processes_num,
+                                      config->halo_size, run_slice, (void *)config);
 }
 
-// generate random number in a given range (inclusively)
-int random_number(int min, int max) { return (rand() % (max - min + 1)) + min; }
-
 int main(int argc, const char **argv) {
 
-    srand(time(NULL));
-
-    int columns_num = DEFAULT_COLUMNS_NUM;
+    const char *columns_text = NULL;
     int iterations_num = DEFAULT_ITERATIONS_NUM;
+    int preimages_num = -1;
+    int state_space = 0;
+    int sweep = 0;
+    const char *cache_directory = NULL;
+    int threads_num = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads_num > ECA_MAX_STATE_SPACE_THREADS) {
+        threads_num = ECA_MAX_STATE_SPACE_THREADS;
+    }
+    int processes_num = 0;
+    int halo_size = 1;
+    const char *transport_name = "sockets";
+    int seed = (int)time(NULL);
+    const char *output_path = NULL;
+    const char *flips = NULL;
+    const char *row_text = NULL;
+    int max_width = 0;
+    int max_height = 0;
+    int queue_length = ECA_DEFAULT_QUEUE_LENGTH;
+    int batch_size = ECA_DEFAULT_BATCH_SIZE >> 10;
+    int direct = 0;
 
     // PARSE OPTIONAL ARGUMENTS
     struct argparse_option options[] = {
@@ -244,10 +582,74 @@ int main(int argc, const char **argv) {
             "population, [0, columns]"),
         OPT_GROUP("optional arguments:"),
         OPT_INTEGER('i', "iterations", &iterations_num,
-                    "number of simulation iterations, [10, 80], default 50", NULL, 0,
+                    "number of simulation iterations including the initial row, "
+                    "[10, 80] in the visualization, default 50",
+                    NULL, 0, 0),
+        OPT_STRING('c', "columns", &columns_text,
+                    "number of columns, [30, 150] in the visualization, default 80",
+                    NULL, 0, 0),
+        OPT_INTEGER('p', "preimages", &preimages_num,
+                    "count the preimages of the initial row and print at most "
+                    "the given number of them instead of the visualization",
+                    NULL, 0, 0),
+        OPT_STRING(0, "row", &row_text,
+                   "row of 0 and 1 analyzed by -p instead of a random one, its "
+                   "length is the number of columns, POPULATION is not required",
+                   NULL, 0, 0),
+        OPT_BOOLEAN('s', "state-space", &state_space,
+                    "analyze all states of a ring of the given number of columns, "
+                    "[1, 36], POPULATION is not required",
+                    NULL, 0, 0),
+        OPT_BOOLEAN('S', "sweep", &sweep,
+                    "run all rules on the same initial row and print a summary of "
+                    "the last iteration of each of them, RULE is not required",
+                    NULL, 0, 0),
+        OPT_STRING(0, "cache", &cache_directory,
+                   "directory keeping the results of sweeps, default none", NULL, 0,
+                   0),
+        OPT_INTEGER('t', "threads", &threads_num,
+                    "number of threads of the state space analysis, [1, 256], "
+                    "default all processors",
+                    NULL, 0, 0),
+        OPT_INTEGER('P', "processes", &processes_num,
+                    "split the ring among the given number of processes and print "
+                    "a summary of the last iteration instead of the visualization",
+                    NULL, 0, 0),
+        OPT_INTEGER('k', "halo", &halo_size,
+                    "number of iterations between exchanges of the halos of the "
+                    "processes, default 1",
+                    NULL, 0, 0),
+        OPT_STRING('T', "transport", &transport_name,
+                   "communication between the processes: sockets, shm or mpi, "
+                   "default sockets",
+                   NULL, 0, 0),
+        OPT_INTEGER(0, "seed", &seed,
+                    "seed of the initial population, default current time",
+                    NULL, 0, 0),
+        OPT_STRING('o', "output", &output_path,
+                   "write the simulation into a .png, .pbm or .raw file instead of "
+                   "the visualization",
+                   NULL, 0, 0),
+        OPT_STRING(0, "flip", &flips,
+                   "flip the given comma separated cells of the first row and "
+                   "update only the changed pixels of an image exported before, "
+                   "the first row is read from the .row file next to it",
+                   NULL, 0, 0),
+        OPT_INTEGER(0, "max-width", &max_width,
+                    "largest width of the exported image, larger simulations are "
+                    "downsampled, default no limit",
+                    NULL, 0, 0),
+        OPT_INTEGER(0, "max-height", &max_height,
+                    "largest height of the exported image, default no limit", NULL,
+                    0, 0),
+        OPT_INTEGER(0, "queue", &queue_length,
+                    "number of batches waiting for the disk, default 8", NULL, 0, 0),
+        OPT_INTEGER(0, "batch", &batch_size,
+                    "size of a batch written at once in KiB, default 4096", NULL, 0,
                     0),
-        OPT_INTEGER('c', "columns", &columns_num,
-                    "number of columns, [30, 150], default 80", NULL, 0, 0),
+        OPT_BOOLEAN(0, "direct", &direct,
+                    "bypass the page cache (O_DIRECT) if the file system allows it",
+                    NULL, 0, 0),
         OPT_HELP(),
         OPT_END(),
     };
@@ -262,7 +664,22 @@ int main(int argc, const char **argv) {
         &argparse, "\nVisual simulation of an elementary cellular automaton.", NULL);
     argc = argparse_parse(&argparse, argc, argv);
 
-    if (argc != 2) {
+    // a distributed ring may be wider than INT_MAX cells, the other modes use
+    // columns_num, which is negative if the number does not fit
+    long long ring_columns_num = DEFAULT_COLUMNS_NUM;
+    if (columns_text != NULL) {
+
+        char *end;
+        ring_columns_num = strtoll(columns_text, &end, 10);
+        if (end == columns_text || *end != '\0') {
+            ring_columns_num = -1;
+        }
+    }
+    int columns_num = (ring_columns_num <= INT_MAX) ? (int)ring_columns_num : -1;
+
+    if (argc != 2 &&
+        !((state_space || sweep || (preimages_num >= 0 && row_text != NULL)) &&
+          argc == 1)) {
 
         fprintf(stderr,
                 "RULE and POPULATION parameters cannot be ommited. Use -h to see the "
@@ -271,9 +688,221 @@ int main(int argc, const char **argv) {
         return 1;
     }
 
+    if (sweep) {
+
+        int population_size = atoi(argv[argc - 1]);
+
+        int error = 0;
+        if (columns_num < 1) {
+            fprintf(stderr, "Incorrect number of columns: %lld\n", ring_columns_num);
+            error = 1;
+        }
+
+        if (iterations_num < 1) {
+            fprintf(stderr, "Incorrect number of iterations: %d\n", iterations_num);
+            error = 1;
+        }
+
+        if (!(0 <= population_size && population_size <= columns_num)) {
+            fprintf(stderr, "Incorrect population size: %d\n", population_size);
+            error = 1;
+        }
+
+        if (error) {
+            return 2;
+        }
+
+        struct eca_config config = {0, columns_num, population_size,
+                                    (unsigned int)seed};
+
+        return sweep_rules(&config, iterations_num, cache_directory);
+    }
+
     // PARSE POSITIONAL ARGUMENTS
     int rule = atoi(argv[0]);
-    int population_size = atoi(argv[1]);
+
+    if (!(0 <= rule && rule <= 255)) {
+        fprintf(stderr, "Incorrect transition rule: %d\n", rule);
+        return 2;
+    }
+
+    if (state_space) {
+
+        int error = 0;
+        if (!(1 <= columns_num && columns_num <= ECA_MAX_STATE_SPACE_COLUMNS)) {
+            fprintf(stderr, "Incorrect number of columns: %lld\n", ring_columns_num);
+            error = 1;
+        }
+
+        if (!(1 <= threads_num && threads_num <= ECA_MAX_STATE_SPACE_THREADS)) {
+            fprintf(stderr, "Incorrect number of threads: %d\n", threads_num);
+            error = 1;
+        }
+
+        if (error) {
+            return 2;
+        }
+
+        return analyze_ring(rule, columns_num, threads_num);
+    }
+
+    if (preimages_num >= 0) {
+
+        // an explicit row sets the number of columns
+        if (row_text != NULL) {
+            columns_num = (int)strlen(row_text);
+        }
+
+        int population_size = (argc == 2) ? atoi(argv[1]) : 0;
+
+        int error = 0;
+        if (row_text != NULL) {
+
+            if (columns_num < 1 || strspn(row_text, "01") != strlen(row_text)) {
+                fprintf(stderr, "Incorrect row: %s\n", row_text);
+                error = 1;
+            }
+        } else {
+
+            if (columns_num < 1) {
+                fprintf(stderr, "Incorrect number of columns: %lld\n",
+                        ring_columns_num);
+                error = 1;
+            }
+
+            if (!(0 <= population_size && population_size <= columns_num)) {
+                fprintf(stderr, "Incorrect population size: %d\n", population_size);
+                error = 1;
+            }
+        }
+
+        if (error) {
+            return 2;
+        }
+
+        unsigned char *row = (unsigned char *)malloc(columns_num);
+        if (row == NULL) {
+            fprintf(stderr, "Not enough memory for %d columns\n", columns_num);
+            return 1;
+        }
+
+        if (row_text != NULL) {
+
+            for (int j = 0; j < columns_num; j++) {
+                row[j] = row_text[j] == '1';
+            }
+        } else {
+
+            struct eca_config config = {rule, columns_num, population_size,
+                                        (unsigned int)seed};
+            struct eca_context *context = eca_create(&config);
+            eca_get_row(context, row);
+            eca_destroy(context);
+        }
+
+        analyze_preimages(rule, row, columns_num, preimages_num);
+        free(row);
+
+        return 0;
+    }
+
+    long long ring_population_size = atoll(argv[1]);
+    int population_size =
+        (ring_population_size <= INT_MAX) ? (int)ring_population_size : -1;
+    int transport_type = eca_parse_transport_type(transport_name);
+
+    if (processes_num > 0 || transport_type == ECA_TRANSPORT_MPI) {
+
+        int error = 0;
+        if (transport_type < 0) {
+            fprintf(stderr, "Incorrect transport: %s\n", transport_name);
+            error = 1;
+        }
+
+        if (halo_size < 1) {
+            fprintf(stderr, "Incorrect halo size: %d\n", halo_size);
+            error = 1;
+        }
+
+        // under MPI the number of processes is known only after starting them
+        if (ring_columns_num < 1 ||
+            (transport_type != ECA_TRANSPORT_MPI &&
+             ring_columns_num < (long long)processes_num * halo_size)) {
+            fprintf(stderr, "Incorrect number of columns: %lld\n", ring_columns_num);
+            error = 1;
+        }
+
+        if (!(0 <= ring_population_size && ring_population_size <= ring_columns_num)) {
+            fprintf(stderr, "Incorrect population size: %lld\n", ring_population_size);
+            error = 1;
+        }
+
+        if (iterations_num < 1) {
+            fprintf(stderr, "Incorrect number of iterations: %d\n", iterations_num);
+            error = 1;
+        }
+
+        if (error) {
+            return 2;
+        }
+
+        struct eca_distributed_config config = {rule,      ring_columns_num,
+                                            iterations_num, ring_population_size,
+                                            halo_size, (unsigned int)seed};
+
+        return run_distributed_simulation(&config, transport_type, processes_num);
+    }
+
+    if (output_path != NULL) {
+
+        int error = 0;
+        if (eca_parse_export_format(output_path) < 0) {
+            fprintf(stderr, "Unknown image format: %s\n", output_path);
+            error = 1;
+        }
+
+        if (columns_num < 1) {
+            fprintf(stderr, "Incorrect number of columns: %lld\n", ring_columns_num);
+            error = 1;
+        }
+
+        if (iterations_num < 1) {
+            fprintf(stderr, "Incorrect number of iterations: %d\n", iterations_num);
+            error = 1;
+        }
+
+        if (!(0 <= population_size && population_size <= columns_num)) {
+            fprintf(stderr, "Incorrect population size: %d\n", population_size);
+            error = 1;
+        }
+
+        if (queue_length < 2 || batch_size < 4) {
+            fprintf(stderr, "Incorrect output queue: %d x %d KiB\n", queue_length,
+                    batch_size);
+            error = 1;
+        }
+
+        if (max_width < 0 || max_height < 0) {
+            fprintf(stderr, "Incorrect image resolution: %d x %d\n", max_width,
+                    max_height);
+            error = 1;
+        }
+
+        if (error) {
+            return 2;
+        }
+
+        struct eca_config config = {rule, columns_num, population_size,
+                                    (unsigned int)seed};
+
+        if (flips != NULL) {
+            return patch_simulation(&config, iterations_num, output_path, max_width,
+                                    max_height, flips);
+        }
+
+        return export_simulation(&config, iterations_num, output_path, max_width,
+                                 max_height, queue_length, batch_size, direct);
+    }
 
     // CHECK ARGUMENTS CORRECTNESS
     int error = 0;
@@ -282,13 +911,8 @@ int main(int argc, const char **argv) {
         error = 1;
     }
 
-    if (!(0 <= rule && rule <= 255)) {
-        fprintf(stderr, "Incorrect transition rule: %d\n", rule);
-        error = 1;
-    }
-
     if (!(30 <= columns_num && columns_num <= 150)) {
-        fprintf(stderr, "Incorrect number of columns: %d\n", columns_num);
+        fprintf(stderr, "Incorrect number of columns: %lld\n", ring_columns_num);
         error = 1;
     }
 
@@ -301,7 +925,9 @@ int main(int argc, const char **argv) {
         return 2;
     }
 
-    run_simulation(rule, population_size, iterations_num, columns_num);
+    struct eca_config config = {rule, columns_num, population_size, (unsigned int)seed};
+
+    run_simulation(&config, iterations_num);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,226 @@
+// Elementary Cellular Automaton - reverse evolution
+// Szymon Golebiowski
+
+#include "preimage.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the state of the cell for the given neighbourhood (4 * left + 2 * middle +
+// right), this is the rule table used by eca_calculate_cell
+#define RULE_BIT(rule, neighbourhood) (((rule) >> (neighbourhood)) & 1)
+
+// a de Bruijn graph node is a pair of neighbouring cells encoded as 2 * a + b,
+// appending cell c to the node (a, b) gives the neighbourhood 4a + 2b + c and
+// leads to the node (b, c)
+#define NEIGHBOURHOOD(node, cell) (((node) << 1) | (cell))
+#define NEXT_NODE(node, cell) (NEIGHBOURHOOD(node, cell) & 3)
+
+struct eca_preimage_enumerator {
+
+    unsigned char *row;
+    int columns_num;
+    int rule;
+
+    // node of the de Bruijn graph the closed walks start from, it holds the
+    // last and the first cell of a preimage
+    int start;
+
+    // bit masks of the nodes from which the walk can still return to the start
+    // node, indexed by the position in the row
+    unsigned char *feasible;
+
+    // the current walk, choices[i] is the cell appended at position i or -1
+    // if none has been tried yet
+    signed char *choices;
+    unsigned char *nodes;
+    int position;
+};
+
+static unsigned long long saturating_add(unsigned long long a,
+                                         unsigned long long b, int *saturated) {
+
+    if (a > ULLONG_MAX - b) {
+        *saturated = 1;
+        return ULLONG_MAX;
+    }
+
+    return a + b;
+}
+
+int eca_count_preimages(const unsigned char *row, int columns_num, int rule,
+                        unsigned long long *count) {
+
+    int saturated = 0;
+    unsigned long long total = 0;
+
+    // the trace of the product of the transfer matrices of the row cells
+    for (int start = 0; start < 4; start++) {
+
+        unsigned long long walks[4] = {0, 0, 0, 0};
+        walks[start] = 1;
+
+        for (int i = 0; i < columns_num; i++) {
+
+            unsigned long long next_walks[4] = {0, 0, 0, 0};
+
+            for (int node = 0; node < 4; node++) {
+
+                if (walks[node] == 0) {
+                    continue;
+                }
+
+                for (int cell = 0; cell < 2; cell++) {
+
+                    if (RULE_BIT(rule, NEIGHBOURHOOD(node, cell)) == row[i]) {
+
+                        int next = NEXT_NODE(node, cell);
+                        next_walks[next] =
+                            saturating_add(next_walks[next], walks[node], &saturated);
+                    }
+                }
+            }
+
+            memcpy(walks, next_walks, sizeof(walks));
+        }
+
+        total = saturating_add(total, walks[start], &saturated);
+    }
+
+    *count = total;
+    return saturated;
+}
+
+int eca_is_garden_of_eden(const unsigned char *row, int columns_num, int rule) {
+
+    unsigned long long count;
+    eca_count_preimages(row, columns_num, rule, &count);
+
+    return count == 0;
+}
+
+// mark the nodes from which a walk over the rest of the row can end in the
+// start node, returns 1 if the walk can leave the start node at all
+static int prepare_start(struct eca_preimage_enumerator *enumerator) {
+
+    int columns_num = enumerator->columns_num;
+    int rule = enumerator->rule;
+    unsigned char *feasible = enumerator->feasible;
+
+    feasible[columns_num - 1] = 1 << enumerator->start;
+
+    for (int i = columns_num - 2; i >= -1; i--) {
+
+        unsigned char mask = 0;
+
+        for (int node = 0; node < 4; node++) {
+            for (int cell = 0; cell < 2; cell++) {
+
+                if (RULE_BIT(rule, NEIGHBOURHOOD(node, cell)) ==
+                        enumerator->row[i + 1] &&
+                    (feasible[i + 1] & (1 << NEXT_NODE(node, cell)))) {
+                    mask |= 1 << node;
+                }
+            }
+        }
+
+        if (i == -1) {
+            return (mask >> enumerator->start) & 1;
+        }
+
+        feasible[i] = mask;
+    }
+
+    return 0;
+}
+
+struct eca_preimage_enumerator *
+eca_preimage_enumerator_create(const unsigned char *row, int columns_num, int rule) {
+
+    struct eca_preimage_enumerator *enumerator = (struct eca_preimage_enumerator *)malloc(
+        sizeof(struct eca_preimage_enumerator));
+
+    enumerator->row = (unsigned char *)malloc(columns_num);
+    memcpy(enumerator->row, row, columns_num);
+
+    enumerator->columns_num = columns_num;
+    enumerator->rule = rule;
+    enumerator->start = -1;
+    enumerator->feasible = (unsigned char *)malloc(columns_num);
+    enumerator->choices = (signed char *)malloc(columns_num);
+    enumerator->nodes = (unsigned char *)malloc(columns_num);
+    enumerator->position = -1;
+
+    return enumerator;
+}
+
+int eca_preimage_enumerator_next(struct eca_preimage_enumerator *enumerator,
+                                 unsigned char *preimage) {
+
+    int columns_num = enumerator->columns_num;
+
+    while (1) {
+
+        // the previous start node is exhausted, move on to the next one
+        if (enumerator->position < 0) {
+
+            enumerator->start++;
+            if (enumerator->start > 3) {
+                enumerator->start = 3;
+                return 0;
+            }
+
+            if (!prepare_start(enumerator)) {
+                continue;
+            }
+
+            enumerator->position = 0;
+            enumerator->choices[0] = -1;
+        }
+
+        int i = enumerator->position;
+        int node = (i == 0) ? enumerator->start : enumerator->nodes[i - 1];
+
+        // look for the next cell which keeps the walk completable
+        int cell = enumerator->choices[i] + 1;
+        for (; cell < 2; cell++) {
+
+            if (RULE_BIT(enumerator->rule, NEIGHBOURHOOD(node, cell)) ==
+                    enumerator->row[i] &&
+                (enumerator->feasible[i] & (1 << NEXT_NODE(node, cell)))) {
+                break;
+            }
+        }
+
+        if (cell == 2) {
+            enumerator->position--;
+            continue;
+        }
+
+        enumerator->choices[i] = cell;
+        enumerator->nodes[i] = NEXT_NODE(node, cell);
+
+        if (i == columns_num - 1) {
+
+            // the walk is closed, the last choice repeats the first cell
+            preimage[0] = enumerator->start & 1;
+            for (int j = 0; j < columns_num - 1; j++) {
+                preimage[j + 1] = enumerator->choices[j];
+            }
+
+            return 1;
+        }
+
+        enumerator->position++;
+        enumerator->choices[i + 1] = -1;
+    }
+}
+
+void eca_preimage_enumerator_delete(struct eca_preimage_enumerator *enumerator) {
+
+    free(enumerator->row);
+    free(enumerator->feasible);
+    free(enumerator->choices);
+    free(enumerator->nodes);
+    free(enumerator);
+}
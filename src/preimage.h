@@ -0,0 +1,46 @@
+// Elementary Cellular Automaton - reverse evolution
+// Szymon Golebiowski
+
+#ifndef ECA_PREIMAGE_H
+#define ECA_PREIMAGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Preimages of a row on a ring are counted and enumerated on the de Bruijn
+// graph of the rule. Its nodes are pairs of neighbouring cells (x[i], x[i+1])
+// and an edge (a, b) -> (b, c) carries the output bit of the rule for the
+// neighbourhood (a, b, c). A preimage of a row of width n is then a closed walk
+// of length n whose edge labels spell the row, so both counting and
+// enumeration run in time linear in the width.
+
+// count the preimages of the given row, the result saturates at ULLONG_MAX
+// returns 1 if the count has saturated, 0 otherwise
+int eca_count_preimages(const unsigned char *row, int columns_num, int rule,
+                        unsigned long long *count);
+
+// check whether the given row has no predecessor (Garden of Eden state)
+int eca_is_garden_of_eden(const unsigned char *row, int columns_num, int rule);
+
+// streaming enumerator which produces one preimage at a time, so that its
+// memory usage does not depend on the number of preimages
+struct eca_preimage_enumerator;
+
+// create an enumerator of the preimages of the given row (the row is copied)
+struct eca_preimage_enumerator *
+eca_preimage_enumerator_create(const unsigned char *row, int columns_num, int rule);
+
+// write the next preimage into the given buffer of columns_num cells
+// returns 1 if a preimage has been written, 0 if there are no more of them
+int eca_preimage_enumerator_next(struct eca_preimage_enumerator *enumerator,
+                                 unsigned char *preimage);
+
+// free memory allocated for an enumerator
+void eca_preimage_enumerator_delete(struct eca_preimage_enumerator *enumerator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
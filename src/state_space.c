@@ -0,0 +1,650 @@
+// Elementary Cellular Automaton - state space analysis
+// Szymon Golebiowski
+
+#include "state_space.h"
+#include "preimage.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// threads take the states in chunks of this size from a shared counter
+#define CHUNK_STATES (1ULL << 16)
+
+// The transition map commutes with rotations of the ring, so it is analyzed on
+// rotation classes, each represented by its smallest state. Classes are
+// numbered in the order of their representatives, the number of a class is
+// the number of representatives in the bitmap below it. The map of the classes
+// is a functional graph: its transient classes are peeled layer by layer
+// starting from those without a predecessor, what remains are the cycles, and
+// the attractors are passed back along the peeled classes, so every class is
+// handled a constant number of times.
+
+// data shared by the threads of the analysis
+struct analysis {
+
+    int rule;
+    int columns_num;
+    int threads_num;
+    uint64_t states_num;
+
+    uint64_t *representatives; // bitmap of the smallest states of their classes
+    uint32_t *ranks;           // number of representatives below every word
+    uint64_t classes_num;
+
+    uint32_t *successors; // class of the successor of every class
+    uint32_t *counters;   // predecessor classes not peeled yet, then attractors
+    uint32_t *order;      // classes in the order of peeling
+    uint64_t layer_begin;
+    uint64_t order_num;
+
+    uint64_t *cycle_states; // representatives of the classes lying on cycles
+    uint64_t cycle_num;
+
+    unsigned long long *in_degree; // histograms of the threads
+    struct eca_state_space *state_space;
+};
+
+struct parallel_job {
+
+    struct analysis *analysis;
+    void (*work)(struct analysis *analysis, uint64_t begin, uint64_t end,
+                 int thread);
+    uint64_t next;
+    uint64_t total;
+};
+
+struct worker {
+
+    struct parallel_job *job;
+    int thread;
+};
+
+static uint64_t columns_mask(int columns_num) {
+    return (1ULL << columns_num) - 1;
+}
+
+// rotate the ring by the given number of cells towards the higher bits
+static uint64_t rotate(uint64_t state, int shift, int columns_num) {
+
+    if (shift == 0) {
+        return state;
+    }
+
+    return ((state << shift) | (state >> (columns_num - shift))) &
+           columns_mask(columns_num);
+}
+
+// calculate the next state of a ring packed into the lowest columns_num bits,
+// cell i lives in bit i
+static uint64_t calculate_packed_iteration(uint64_t state, int rule, int columns_num) {
+
+    uint64_t mask = columns_mask(columns_num);
+
+    // cell i sees its left neighbour i - 1 and its right neighbour i + 1
+    uint64_t upper_left = rotate(state, 1, columns_num);
+    uint64_t upper_middle = state;
+    uint64_t upper_right = rotate(state, columns_num - 1, columns_num);
+
+    uint64_t next = 0;
+    for (int upper_cells_type = 0; upper_cells_type < 8; upper_cells_type++) {
+
+        if (!(rule & (1 << upper_cells_type))) {
+            continue;
+        }
+
+        uint64_t left = (upper_cells_type & 4) ? upper_left : ~upper_left;
+        uint64_t middle = (upper_cells_type & 2) ? upper_middle : ~upper_middle;
+        uint64_t right = (upper_cells_type & 1) ? upper_right : ~upper_right;
+
+        next |= left & middle & right;
+    }
+
+    return next & mask;
+}
+
+// the smallest of all rotations of the state
+static uint64_t canonical_state(uint64_t state, int columns_num) {
+
+    uint64_t canonical = state;
+    for (int shift = 1; shift < columns_num; shift++) {
+
+        uint64_t rotated = rotate(state, shift, columns_num);
+        if (rotated < canonical) {
+            canonical = rotated;
+        }
+    }
+
+    return canonical;
+}
+
+static int is_canonical_state(uint64_t state, int columns_num) {
+
+    for (int shift = 1; shift < columns_num; shift++) {
+        if (rotate(state, shift, columns_num) < state) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// number of distinct rotations of the state
+static int orbit_size(uint64_t state, int columns_num) {
+
+    for (int shift = 1; shift < columns_num; shift++) {
+        if (rotate(state, shift, columns_num) == state) {
+            return shift;
+        }
+    }
+
+    return columns_num;
+}
+
+static int get_bit(const uint64_t *bitmap, uint64_t state) {
+    return (bitmap[state >> 6] >> (state & 63)) & 1;
+}
+
+static uint64_t bitmap_words(uint64_t states_num) {
+    return (states_num + 63) / 64;
+}
+
+static void *run_worker(void *arg) {
+
+    struct worker *worker = (struct worker *)arg;
+    struct parallel_job *job = worker->job;
+
+    while (1) {
+
+        uint64_t begin = __atomic_fetch_add(&job->next, CHUNK_STATES, __ATOMIC_RELAXED);
+        if (begin >= job->total) {
+            break;
+        }
+
+        uint64_t end = begin + CHUNK_STATES;
+        if (end > job->total) {
+            end = job->total;
+        }
+
+        job->work(job->analysis, begin, end, worker->thread);
+    }
+
+    return NULL;
+}
+
+// call the work function for the range [0, total), split among the threads
+static void parallel_for(struct analysis *analysis,
+                         void (*work)(struct analysis *analysis, uint64_t begin,
+                                      uint64_t end, int thread),
+                         uint64_t total) {
+
+    struct parallel_job job = {analysis, work, 0, total};
+
+    pthread_t *threads =
+        (pthread_t *)malloc(analysis->threads_num * sizeof(pthread_t));
+    struct worker *workers =
+        (struct worker *)malloc(analysis->threads_num * sizeof(struct worker));
+
+    int created = 0;
+    if (threads != NULL && workers != NULL) {
+
+        for (; created < analysis->threads_num; created++) {
+
+            workers[created].job = &job;
+            workers[created].thread = created;
+            if (pthread_create(&threads[created], NULL, run_worker,
+                               &workers[created]) != 0) {
+                break;
+            }
+        }
+    }
+
+    // the calling thread takes the place of the first thread which could not
+    // be created and takes the chunks the others leave
+    if (created < analysis->threads_num) {
+        struct worker worker = {&job, created};
+        run_worker(&worker);
+    }
+
+    for (int i = 0; i < created; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(workers);
+    free(threads);
+}
+
+// the number of the class represented by the given state
+static uint32_t class_index(const struct analysis *analysis, uint64_t state) {
+
+    uint64_t below = analysis->representatives[state >> 6] &
+                     ((1ULL << (state & 63)) - 1);
+
+    return analysis->ranks[state >> 6] + (uint32_t)__builtin_popcountll(below);
+}
+
+static void representatives_work(struct analysis *analysis, uint64_t begin,
+                                 uint64_t end, int thread) {
+
+    (void)thread;
+
+    // the chunks are multiples of whole words
+    for (uint64_t word = begin; word < end; word += 64) {
+
+        uint64_t bits = 0;
+        for (uint64_t state = word; state < word + 64 && state < end; state++) {
+            if (is_canonical_state(state, analysis->columns_num)) {
+                bits |= 1ULL << (state - word);
+            }
+        }
+
+        analysis->representatives[word >> 6] = bits;
+    }
+}
+
+// the successor class and the number of predecessor states of every class,
+// both the in-degree and the basin are the same for all states of a class
+static void successors_work(struct analysis *analysis, uint64_t begin,
+                            uint64_t end, int thread) {
+
+    int rule = analysis->rule;
+    int columns_num = analysis->columns_num;
+    unsigned long long *in_degree =
+        &analysis->in_degree[thread * ECA_IN_DEGREE_BUCKETS];
+    unsigned char row[ECA_MAX_STATE_SPACE_COLUMNS];
+
+    for (uint64_t state = begin; state < end; state++) {
+
+        if (!get_bit(analysis->representatives, state)) {
+            continue;
+        }
+
+        uint64_t next = canonical_state(
+            calculate_packed_iteration(state, rule, columns_num), columns_num);
+        uint32_t next_class = class_index(analysis, next);
+
+        analysis->successors[class_index(analysis, state)] = next_class;
+        __atomic_fetch_add(&analysis->counters[next_class], 1, __ATOMIC_RELAXED);
+
+        for (int i = 0; i < columns_num; i++) {
+            row[i] = (state >> i) & 1;
+        }
+
+        unsigned long long count;
+        eca_count_preimages(row, columns_num, rule, &count);
+        in_degree[count < ECA_IN_DEGREE_BUCKETS ? count : ECA_IN_DEGREE_BUCKETS - 1] +=
+            orbit_size(state, columns_num);
+    }
+}
+
+static void append_class(struct analysis *analysis, uint32_t index) {
+
+    uint64_t position = __atomic_fetch_add(&analysis->order_num, 1, __ATOMIC_RELAXED);
+    analysis->order[position] = index;
+}
+
+// the classes without a predecessor form the first layer
+static void sources_work(struct analysis *analysis, uint64_t begin, uint64_t end,
+                         int thread) {
+
+    (void)thread;
+
+    for (uint64_t i = begin; i < end; i++) {
+        if (analysis->counters[i] == 0) {
+            append_class(analysis, (uint32_t)i);
+        }
+    }
+}
+
+// remove the classes of the current layer, the successors which lose their
+// last predecessor form the next one
+static void peel_work(struct analysis *analysis, uint64_t begin, uint64_t end,
+                      int thread) {
+
+    (void)thread;
+
+    for (uint64_t i = analysis->layer_begin + begin; i < analysis->layer_begin + end;
+         i++) {
+
+        uint32_t next = analysis->successors[analysis->order[i]];
+        if (__atomic_sub_fetch(&analysis->counters[next], 1, __ATOMIC_RELAXED) == 0) {
+            append_class(analysis, next);
+        }
+    }
+}
+
+// the successors of a layer have been peeled later, so they are already labeled
+static void label_work(struct analysis *analysis, uint64_t begin, uint64_t end,
+                       int thread) {
+
+    (void)thread;
+
+    for (uint64_t i = analysis->layer_begin + begin; i < analysis->layer_begin + end;
+         i++) {
+
+        uint32_t index = analysis->order[i];
+        analysis->counters[index] = analysis->counters[analysis->successors[index]];
+    }
+}
+
+// list the representatives of the classes which have not been peeled
+static void cycles_work(struct analysis *analysis, uint64_t begin, uint64_t end,
+                        int thread) {
+
+    (void)thread;
+
+    for (uint64_t state = begin; state < end; state++) {
+
+        if (get_bit(analysis->representatives, state) &&
+            analysis->counters[class_index(analysis, state)] > 0) {
+
+            uint64_t position =
+                __atomic_fetch_add(&analysis->cycle_num, 1, __ATOMIC_RELAXED);
+            analysis->cycle_states[position] = state;
+        }
+    }
+}
+
+static void basins_work(struct analysis *analysis, uint64_t begin, uint64_t end,
+                        int thread) {
+
+    (void)thread;
+
+    for (uint64_t state = begin; state < end; state++) {
+
+        if (!get_bit(analysis->representatives, state)) {
+            continue;
+        }
+
+        uint32_t attractor = analysis->counters[class_index(analysis, state)];
+        __atomic_fetch_add(&analysis->state_space->attractors[attractor].basin_size,
+                           orbit_size(state, analysis->columns_num), __ATOMIC_RELAXED);
+    }
+}
+
+// run the work on the current layer, small layers in the calling thread
+static void layer_for(struct analysis *analysis,
+                      void (*work)(struct analysis *analysis, uint64_t begin,
+                                   uint64_t end, int thread),
+                      uint64_t begin, uint64_t end) {
+
+    analysis->layer_begin = begin;
+
+    if (end - begin <= CHUNK_STATES) {
+        work(analysis, 0, end - begin, 0);
+    } else {
+        parallel_for(analysis, work, end - begin);
+    }
+}
+
+static int compare_states(const void *a, const void *b) {
+
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int compare_by_state(const void *a, const void *b) {
+
+    const struct eca_attractor *x = (const struct eca_attractor *)a;
+    const struct eca_attractor *y = (const struct eca_attractor *)b;
+
+    return (x->state > y->state) - (x->state < y->state);
+}
+
+static int compare_by_basin(const void *a, const void *b) {
+
+    const struct eca_attractor *x = (const struct eca_attractor *)a;
+    const struct eca_attractor *y = (const struct eca_attractor *)b;
+
+    if (x->basin_size != y->basin_size) {
+        return (x->basin_size < y->basin_size) - (x->basin_size > y->basin_size);
+    }
+
+    return compare_by_state(a, b);
+}
+
+static uint64_t greatest_common_divisor(uint64_t a, uint64_t b) {
+
+    while (b != 0) {
+        uint64_t rest = a % b;
+        a = b;
+        b = rest;
+    }
+
+    return a;
+}
+
+// find the attractor of every cycle of classes, the classes of a cycle share
+// the size of their rotation orbit, if the states come back rotated by shift
+// after going once around the cycle of length classes, the period of a state
+// is classes * orbit / gcd(shift, orbit) and its cycle has gcd(shift, orbit)
+// rotated copies, returns 0 on success
+static int find_attractors(struct analysis *analysis) {
+
+    struct eca_state_space *state_space = analysis->state_space;
+    int rule = analysis->rule;
+    int columns_num = analysis->columns_num;
+
+    uint64_t *states = analysis->cycle_states;
+    uint64_t states_num = analysis->cycle_num;
+
+    // the states are sorted, so the class of a listed state is found by its
+    // position, every class is assigned its attractor
+    qsort(states, states_num, sizeof(uint64_t), compare_states);
+    uint32_t *attractors = (uint32_t *)malloc(states_num * sizeof(uint32_t));
+    if (attractors == NULL) {
+        return 1;
+    }
+
+    for (uint64_t i = 0; i < states_num; i++) {
+        attractors[i] = UINT32_MAX;
+    }
+
+    int capacity = 0;
+    for (uint64_t i = 0; i < states_num; i++) {
+
+        if (attractors[i] != UINT32_MAX) {
+            continue;
+        }
+
+        if (state_space->attractors_num == capacity) {
+
+            capacity = 2 * capacity + 16;
+            struct eca_attractor *resized = (struct eca_attractor *)realloc(
+                state_space->attractors, capacity * sizeof(struct eca_attractor));
+            if (resized == NULL) {
+                free(attractors);
+                return 1;
+            }
+            state_space->attractors = resized;
+        }
+
+        // the smallest listed state of the cycle is met first
+        int attractor = state_space->attractors_num++;
+        uint64_t state = states[i];
+        uint64_t classes = 0;
+        uint64_t j = i;
+
+        do {
+            attractors[j] = (uint32_t)attractor;
+            classes++;
+
+            uint64_t next = canonical_state(
+                calculate_packed_iteration(states[j], rule, columns_num), columns_num);
+            j = (uint64_t *)bsearch(&next, states, states_num, sizeof(uint64_t),
+                                    compare_states) -
+                states;
+        } while (j != i);
+
+        uint64_t returned = state;
+        for (uint64_t k = 0; k < classes; k++) {
+            returned = calculate_packed_iteration(returned, rule, columns_num);
+        }
+
+        int orbit = orbit_size(state, columns_num);
+        int shift = 0;
+        while (rotate(state, shift, columns_num) != returned) {
+            shift++;
+        }
+
+        int copies = (int)greatest_common_divisor((uint64_t)shift, (uint64_t)orbit);
+
+        state_space->attractors[attractor].state = state;
+        state_space->attractors[attractor].period = classes * (orbit / copies);
+        state_space->attractors[attractor].cycles_num = copies;
+        state_space->attractors[attractor].basin_size = 0;
+        state_space->recurrent_num += classes * orbit;
+    }
+
+    for (uint64_t i = 0; i < states_num; i++) {
+        analysis->counters[class_index(analysis, states[i])] = attractors[i];
+    }
+
+    free(attractors);
+
+    return 0;
+}
+
+static void free_analysis(struct analysis *analysis) {
+
+    free(analysis->representatives);
+    free(analysis->ranks);
+    free(analysis->successors);
+    free(analysis->counters);
+    free(analysis->order);
+    free(analysis->cycle_states);
+    free(analysis->in_degree);
+}
+
+int eca_analyze_state_space(int rule, int columns_num, int threads_num,
+                            struct eca_state_space *state_space) {
+
+    if (columns_num < 1 || columns_num > ECA_MAX_STATE_SPACE_COLUMNS) {
+        return 1;
+    }
+
+    memset(state_space, 0, sizeof(struct eca_state_space));
+    state_space->rule = rule;
+    state_space->columns_num = columns_num;
+
+    struct analysis analysis;
+    memset(&analysis, 0, sizeof(struct analysis));
+    analysis.rule = rule;
+    analysis.columns_num = columns_num;
+    analysis.threads_num = (threads_num > 0) ? threads_num : 1;
+    if (analysis.threads_num > ECA_MAX_STATE_SPACE_THREADS) {
+        analysis.threads_num = ECA_MAX_STATE_SPACE_THREADS;
+    }
+    analysis.states_num = 1ULL << columns_num;
+    analysis.state_space = state_space;
+    state_space->states_num = analysis.states_num;
+
+    uint64_t words = bitmap_words(analysis.states_num);
+    analysis.representatives = (uint64_t *)malloc(words * sizeof(uint64_t));
+    analysis.ranks = (uint32_t *)malloc(words * sizeof(uint32_t));
+    analysis.in_degree = (unsigned long long *)calloc(
+        analysis.threads_num * ECA_IN_DEGREE_BUCKETS, sizeof(unsigned long long));
+
+    if (analysis.representatives == NULL || analysis.ranks == NULL ||
+        analysis.in_degree == NULL) {
+        free_analysis(&analysis);
+        return 2;
+    }
+
+    parallel_for(&analysis, representatives_work, analysis.states_num);
+
+    for (uint64_t i = 0; i < words; i++) {
+        analysis.ranks[i] = (uint32_t)analysis.classes_num;
+        analysis.classes_num += __builtin_popcountll(analysis.representatives[i]);
+    }
+
+    uint64_t classes_num = analysis.classes_num;
+    analysis.successors = (uint32_t *)malloc(classes_num * sizeof(uint32_t));
+    analysis.counters = (uint32_t *)calloc(classes_num, sizeof(uint32_t));
+    analysis.order = (uint32_t *)malloc(classes_num * sizeof(uint32_t));
+
+    if (analysis.successors == NULL || analysis.counters == NULL ||
+        analysis.order == NULL) {
+        free_analysis(&analysis);
+        return 2;
+    }
+
+    parallel_for(&analysis, successors_work, analysis.states_num);
+
+    for (int i = 0; i < analysis.threads_num; i++) {
+        for (int j = 0; j < ECA_IN_DEGREE_BUCKETS; j++) {
+            state_space->in_degree[j] +=
+                analysis.in_degree[i * ECA_IN_DEGREE_BUCKETS + j];
+        }
+    }
+    state_space->garden_of_eden_num = state_space->in_degree[0];
+
+    // the layers follow each other in the order, the number of layers is the
+    // longest transient
+    uint64_t *layers = NULL;
+    int layers_capacity = 0;
+
+    parallel_for(&analysis, sources_work, classes_num);
+    uint64_t begin = 0;
+
+    while (begin < analysis.order_num) {
+
+        if (state_space->transient_length + 1 >= layers_capacity) {
+
+            layers_capacity = 2 * layers_capacity + 64;
+            uint64_t *resized =
+                (uint64_t *)realloc(layers, layers_capacity * sizeof(uint64_t));
+            if (resized == NULL) {
+                free(layers);
+                free_analysis(&analysis);
+                return 2;
+            }
+            layers = resized;
+        }
+
+        uint64_t end = analysis.order_num;
+        layers[state_space->transient_length++] = begin;
+        layer_for(&analysis, peel_work, begin, end);
+        begin = end;
+    }
+
+    analysis.cycle_states =
+        (uint64_t *)malloc((classes_num - analysis.order_num) * sizeof(uint64_t));
+    if (analysis.cycle_states == NULL) {
+        free(layers);
+        free_analysis(&analysis);
+        return 2;
+    }
+
+    parallel_for(&analysis, cycles_work, analysis.states_num);
+
+    if (find_attractors(&analysis) != 0) {
+        free(layers);
+        free_analysis(&analysis);
+        eca_delete_state_space(state_space);
+        return 2;
+    }
+
+    for (int i = state_space->transient_length; i > 0; i--) {
+        uint64_t end = (i == state_space->transient_length) ? analysis.order_num
+                                                            : layers[i];
+        layer_for(&analysis, label_work, layers[i - 1], end);
+    }
+
+    parallel_for(&analysis, basins_work, analysis.states_num);
+    qsort(state_space->attractors, state_space->attractors_num,
+          sizeof(struct eca_attractor), compare_by_basin);
+
+    free(layers);
+    free_analysis(&analysis);
+
+    return 0;
+}
+
+void eca_delete_state_space(struct eca_state_space *state_space) {
+
+    free(state_space->attractors);
+    state_space->attractors = NULL;
+    state_space->attractors_num = 0;
+}
@@ -0,0 +1,60 @@
+// Elementary Cellular Automaton - state space analysis
+// Szymon Golebiowski
+
+#ifndef ECA_STATE_SPACE_H
+#define ECA_STATE_SPACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the whole state space of a ring of width n has 2^n states, kept in bitmaps
+#define ECA_MAX_STATE_SPACE_COLUMNS 36
+
+// more threads are not created even if requested
+#define ECA_MAX_STATE_SPACE_THREADS 256
+
+// the last bucket of the in-degree distribution gathers all greater in-degrees
+#define ECA_IN_DEGREE_BUCKETS 16
+
+// cycles which are rotations of each other are reported as one attractor
+struct eca_attractor {
+
+    uint64_t state;                 // the smallest state of all its cycles
+    unsigned long long period;      // length of each cycle
+    int cycles_num;                 // number of rotated copies of the cycle
+    unsigned long long basin_size;  // number of states ending in its cycles
+};
+
+struct eca_state_space {
+
+    int rule;
+    int columns_num;
+
+    unsigned long long states_num;
+    unsigned long long garden_of_eden_num; // states without a predecessor
+    unsigned long long recurrent_num;      // states lying on cycles
+    int transient_length;                  // the longest path to a cycle
+
+    int attractors_num;
+    struct eca_attractor *attractors;          // sorted by basin size, descending
+
+    unsigned long long in_degree[ECA_IN_DEGREE_BUCKETS];
+};
+
+// explore the state transition graph of the rule on a ring of the given width
+// using threads_num threads, at least one and at most
+// ECA_MAX_STATE_SPACE_THREADS, returns 0 on success
+int eca_analyze_state_space(int rule, int columns_num, int threads_num,
+                            struct eca_state_space *state_space);
+
+// free memory allocated for the analysis results
+void eca_delete_state_space(struct eca_state_space *state_space);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
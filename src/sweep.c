@@ -0,0 +1,321 @@
+// Elementary Cellular Automaton - sweeps over all rules
+// Szymon Golebiowski
+
+#include "sweep.h"
+#include "equivalence.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "ECASWEEP"
+#define CACHE_VERSION 2
+
+// cache files are named after the representative, the size of the simulation
+// and the hash of the initial row, the row itself is stored to rule out
+// collisions, followed by the last row, both of them packed into bits
+struct cache_header {
+
+    char magic[8];
+    int version;
+    int rule;
+    int columns_num;
+    long long iterations_num;
+};
+
+// the initial row seen through one of the transforms, rotated to the smallest
+// of its rotations
+struct initial_row {
+
+    unsigned char *cells;
+    int shift; // the transformed row rotated left by shift gives cells
+    int id;    // the smallest transform giving the same cells
+};
+
+// FNV-1a of the packed row
+static unsigned long long hash_row(const unsigned char *packed, int size) {
+
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < size; i++) {
+        hash = (hash ^ packed[i]) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static void cache_path(char *path, size_t size, const char *cache_directory,
+                       int rule, int columns_num, long long iterations_num,
+                       const unsigned char *packed_initial) {
+
+    snprintf(path, size, "%s/r%03d-c%d-i%lld-%016llx.eca", cache_directory, rule,
+             columns_num, iterations_num,
+             hash_row(packed_initial, (columns_num + 7) / 8));
+}
+
+// read the last row of the given simulation, returns 0 if it has been found
+static int read_cache(const char *path, int rule, int columns_num,
+                      long long iterations_num, const unsigned char *packed_initial,
+                      unsigned char *packed_last) {
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return 1;
+    }
+
+    int packed_size = (columns_num + 7) / 8;
+    unsigned char *stored_initial = (unsigned char *)malloc(packed_size);
+
+    struct cache_header header;
+    int error = fread(&header, sizeof(header), 1, file) != 1 ||
+                memcmp(header.magic, CACHE_MAGIC, 8) != 0 ||
+                header.version != CACHE_VERSION || header.rule != rule ||
+                header.columns_num != columns_num ||
+                header.iterations_num != iterations_num;
+
+    if (!error) {
+        error = fread(stored_initial, packed_size, 1, file) != 1 ||
+                memcmp(stored_initial, packed_initial, packed_size) != 0 ||
+                fread(packed_last, packed_size, 1, file) != 1;
+    }
+
+    free(stored_initial);
+    fclose(file);
+
+    return error;
+}
+
+// store the last row of the given simulation, the file is written under
+// a temporary name and renamed, so concurrent sweeps never see a partial one
+static void write_cache(const char *path, int rule, int columns_num,
+                        long long iterations_num,
+                        const unsigned char *packed_initial,
+                        const unsigned char *packed_last) {
+
+    char temporary_path[4096 + 32];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.%d.tmp", path,
+             (int)getpid());
+
+    FILE *file = fopen(temporary_path, "wb");
+    if (file == NULL) {
+        return;
+    }
+
+    struct cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, 8);
+    header.version = CACHE_VERSION;
+    header.rule = rule;
+    header.columns_num = columns_num;
+    header.iterations_num = iterations_num;
+
+    int packed_size = (columns_num + 7) / 8;
+    int error = fwrite(&header, sizeof(header), 1, file) != 1 ||
+                fwrite(packed_initial, packed_size, 1, file) != 1 ||
+                fwrite(packed_last, packed_size, 1, file) != 1;
+
+    error |= fclose(file) != 0;
+
+    if (error || rename(temporary_path, path) != 0) {
+        unlink(temporary_path);
+    }
+}
+
+// pick the transform of the rule to its representative under which the
+// representative sees the smallest initial row, so that the choice does not
+// depend on which rotation, mirror image or complement of the row is given
+static int choose_transform(int rule, int representative,
+                            const struct initial_row *initial_rows,
+                            int columns_num) {
+
+    int best = -1;
+
+    for (int t = 0; t < ECA_TRANSFORMS_NUM; t++) {
+
+        if (eca_transform_rule(rule, t) != representative) {
+            continue;
+        }
+
+        if (best < 0 || memcmp(initial_rows[t].cells, initial_rows[best].cells,
+                               columns_num) < 0) {
+            best = t;
+        }
+    }
+
+    return best;
+}
+
+static void summarize_row(const unsigned char *row, int columns_num,
+                          struct eca_sweep_result *result) {
+
+    result->population = 0;
+    result->checksum = 0;
+
+    for (int i = 0; i < columns_num; i++) {
+        if (row[i]) {
+            result->population++;
+            result->checksum += eca_mix((unsigned long long)i);
+        }
+    }
+}
+
+int eca_run_sweep(const struct eca_config *config, long long iterations_num,
+                  const char *cache_directory, struct eca_sweep_result *results) {
+
+    int columns_num = config->columns_num;
+    int packed_size = (columns_num + 7) / 8;
+
+    struct eca_config initial_config = *config;
+    initial_config.rule = 0;
+
+    struct eca_context *context = eca_create(&initial_config);
+    if (context == NULL || iterations_num < 1) {
+        if (context != NULL) {
+            eca_destroy(context);
+        }
+        return 1;
+    }
+
+    if (cache_directory != NULL && mkdir(cache_directory, 0777) != 0 &&
+        errno != EEXIST) {
+        eca_destroy(context);
+        return 1;
+    }
+
+    unsigned char *initial = (unsigned char *)malloc(columns_num);
+    unsigned char *transformed = (unsigned char *)malloc(columns_num);
+    unsigned char *last = (unsigned char *)malloc(columns_num);
+    unsigned char *derived = (unsigned char *)malloc(columns_num);
+    unsigned char *packed_initial = (unsigned char *)malloc(packed_size);
+    unsigned char *packed_last = (unsigned char *)malloc(packed_size);
+    eca_get_row(context, initial);
+
+    struct initial_row initial_rows[ECA_TRANSFORMS_NUM];
+    for (int t = 0; t < ECA_TRANSFORMS_NUM; t++) {
+
+        eca_transform_row(initial, transformed, columns_num, t);
+        initial_rows[t].shift = eca_least_rotation(transformed, columns_num);
+        initial_rows[t].cells = (unsigned char *)malloc(columns_num);
+        eca_rotate_row(transformed, initial_rows[t].cells, columns_num,
+                       initial_rows[t].shift);
+
+        // e.g. a symmetric row is the same simulation under the mirror
+        initial_rows[t].id = t;
+        for (int u = 0; u < t; u++) {
+            if (memcmp(initial_rows[u].cells, initial_rows[t].cells, columns_num) ==
+                0) {
+                initial_rows[t].id = u;
+                break;
+            }
+        }
+    }
+
+    // every rule is assigned the simulation of its representative on one of the
+    // transformed initial rows
+    int keys[ECA_RULES_NUM];
+    for (int rule = 0; rule < ECA_RULES_NUM; rule++) {
+
+        struct eca_sweep_result *result = &results[rule];
+        result->rule = rule;
+        result->representative = eca_canonical_rule(rule, NULL);
+        result->transform =
+            choose_transform(rule, result->representative, initial_rows, columns_num);
+
+        keys[rule] = result->representative * ECA_TRANSFORMS_NUM +
+                     initial_rows[result->transform].id;
+    }
+
+    int done[ECA_RULES_NUM * ECA_TRANSFORMS_NUM];
+    memset(done, 0, sizeof(done));
+
+    for (int rule = 0; rule < ECA_RULES_NUM; rule++) {
+
+        if (done[keys[rule]]) {
+            continue;
+        }
+        done[keys[rule]] = 1;
+
+        int representative = results[rule].representative;
+        const unsigned char *cells = initial_rows[results[rule].transform].cells;
+        eca_pack_row(cells, packed_initial, columns_num);
+
+        char path[4096];
+        int source = ECA_SWEEP_COMPUTED;
+
+        if (cache_directory != NULL) {
+
+            cache_path(path, sizeof(path), cache_directory, representative,
+                       columns_num, iterations_num, packed_initial);
+
+            if (read_cache(path, representative, columns_num, iterations_num,
+                           packed_initial, packed_last) == 0) {
+                eca_unpack_row(packed_last, last, columns_num);
+                source = ECA_SWEEP_CACHED;
+            }
+        }
+
+        if (source == ECA_SWEEP_COMPUTED) {
+
+            struct eca_config representative_config = {representative, columns_num,
+                                                       0, 0};
+            struct eca_context *simulation = eca_create(&representative_config);
+
+            eca_set_row(simulation, cells);
+            eca_step(simulation, iterations_num - 1);
+            eca_get_row(simulation, last);
+            eca_destroy(simulation);
+
+            if (cache_directory != NULL) {
+                eca_pack_row(last, packed_last, columns_num);
+                write_cache(path, representative, columns_num, iterations_num,
+                            packed_initial, packed_last);
+            }
+        }
+
+        // undo the rotation and the transform for every rule sharing the result
+        for (int other = rule; other < ECA_RULES_NUM; other++) {
+
+            if (keys[other] != keys[rule]) {
+                continue;
+            }
+
+            struct eca_sweep_result *result = &results[other];
+            const struct initial_row *initial_row = &initial_rows[result->transform];
+
+            eca_rotate_row(last, transformed, columns_num,
+                           (columns_num - initial_row->shift) % columns_num);
+            eca_transform_row(transformed, derived, columns_num, result->transform);
+
+            summarize_row(derived, columns_num, result);
+            // one rule stands for the simulation or the cache file
+            result->source = (other == rule) ? source : ECA_SWEEP_DERIVED;
+        }
+    }
+
+    for (int t = 0; t < ECA_TRANSFORMS_NUM; t++) {
+        free(initial_rows[t].cells);
+    }
+
+    free(initial);
+    free(transformed);
+    free(last);
+    free(derived);
+    free(packed_initial);
+    free(packed_last);
+    eca_destroy(context);
+
+    return 0;
+}
+
+const char *eca_sweep_source_name(int source) {
+
+    switch (source) {
+    case ECA_SWEEP_COMPUTED:
+        return "computed";
+    case ECA_SWEEP_DERIVED:
+        return "derived";
+    default:
+        return "cached";
+    }
+}
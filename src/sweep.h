@@ -0,0 +1,53 @@
+// Elementary Cellular Automaton - sweeps over all rules
+// Szymon Golebiowski
+
+#ifndef ECA_SWEEP_H
+#define ECA_SWEEP_H
+
+#include "eca.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// All 256 rules are run on the same initial row, every one of them as its
+// class representative on the mirrored or inverted row. The members of a class
+// see different rows, so they share a simulation only if the initial row is
+// symmetric up to a rotation, a random row needs all 256. The last rows can be
+// kept in a directory, so that later sweeps of the same row, or of its
+// rotations, mirror images and complements, skip the simulations.
+
+#define ECA_RULES_NUM 256
+
+// every simulation and every file read from the cache is counted once, by the
+// first rule using it, the other rules sharing it are derived
+enum eca_sweep_source {
+    ECA_SWEEP_COMPUTED, // simulated during this sweep
+    ECA_SWEEP_DERIVED,  // transformed result of an earlier rule of this sweep
+    ECA_SWEEP_CACHED,   // result read from the cache directory
+};
+
+struct eca_sweep_result {
+
+    int rule;
+    int representative;           // the smallest rule of the class
+    int transform;                // transform from the rule to the representative
+    int source;
+    unsigned long long population; // live cells of the last iteration
+    unsigned long long checksum;   // hash of the positions of the live cells
+};
+
+// run every rule for iterations_num iterations starting from the random row
+// given by config (its rule is ignored), the initial row is the first of them,
+// so the last one is reached after iterations_num - 1 steps, the results are
+// indexed by the rule, cache_directory may be NULL, returns 0 on success
+int eca_run_sweep(const struct eca_config *config, long long iterations_num,
+                  const char *cache_directory, struct eca_sweep_result *results);
+
+const char *eca_sweep_source_name(int source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
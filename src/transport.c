@@ -0,0 +1,572 @@
+// Elementary Cellular Automaton - communication between processes
+// Szymon Golebiowski
+
+#include "transport.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef ECA_HAVE_MPI
+#include <mpi.h>
+#endif
+
+struct socket_transport {
+
+    int left_fd;  // connected to the right end of the left neighbour
+    int right_fd; // connected to the left end of the right neighbour
+};
+
+// shared by all processes, followed by two mailboxes of every process
+struct shared_memory_header {
+
+    pthread_barrier_t barrier;
+    int max_size;
+    unsigned long long values[];
+};
+
+struct shared_memory_transport {
+
+    struct shared_memory_header *header;
+    size_t length;
+};
+
+int eca_parse_transport_type(const char *name) {
+
+    if (strcmp(name, "sockets") == 0) {
+        return ECA_TRANSPORT_SOCKETS;
+    }
+
+    if (strcmp(name, "shm") == 0) {
+        return ECA_TRANSPORT_SHARED_MEMORY;
+    }
+
+    if (strcmp(name, "mpi") == 0) {
+        return ECA_TRANSPORT_MPI;
+    }
+
+    return -1;
+}
+
+// send and receive on both sockets at once, so that neither of the neighbours
+// waits for the other one when the buffers do not fit in the socket buffers
+static int socket_exchange(struct eca_transport *transport,
+                           const unsigned char *to_left,
+                           const unsigned char *to_right, unsigned char *from_left,
+                           unsigned char *from_right, int size) {
+
+    struct socket_transport *sockets = (struct socket_transport *)transport->data;
+
+    const unsigned char *out[2] = {to_left, to_right};
+    unsigned char *in[2] = {from_left, from_right};
+    int fds[2] = {sockets->left_fd, sockets->right_fd};
+    int sent[2] = {0, 0}, received[2] = {0, 0};
+
+    while (sent[0] < size || sent[1] < size || received[0] < size ||
+           received[1] < size) {
+
+        struct pollfd polls[2];
+        for (int i = 0; i < 2; i++) {
+
+            polls[i].fd = fds[i];
+            polls[i].events = 0;
+            polls[i].revents = 0;
+
+            if (sent[i] < size) {
+                polls[i].events |= POLLOUT;
+            }
+            if (received[i] < size) {
+                polls[i].events |= POLLIN;
+            }
+        }
+
+        if (poll(polls, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+
+        for (int i = 0; i < 2; i++) {
+
+            if (polls[i].revents & POLLOUT) {
+
+                ssize_t n = send(fds[i], out[i] + sent[i], size - sent[i],
+                                 MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (n > 0) {
+                    sent[i] += n;
+                } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    return 1;
+                }
+            }
+
+            if (polls[i].revents & POLLIN) {
+
+                ssize_t n = recv(fds[i], in[i] + received[i], size - received[i],
+                                 MSG_DONTWAIT);
+                if (n > 0) {
+                    received[i] += n;
+                } else if (n == 0 ||
+                           (n < 0 && errno != EAGAIN && errno != EINTR)) {
+                    return 1;
+                }
+            }
+
+            if ((polls[i].revents & (POLLERR | POLLNVAL)) ||
+                ((polls[i].revents & POLLHUP) && received[i] < size &&
+                 !(polls[i].revents & POLLIN))) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int write_all(int fd, const void *buffer, size_t size) {
+
+    const unsigned char *data = (const unsigned char *)buffer;
+    while (size > 0) {
+
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 1;
+        }
+
+        data += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+static int read_all(int fd, void *buffer, size_t size) {
+
+    unsigned char *data = (unsigned char *)buffer;
+    while (size > 0) {
+
+        ssize_t n = recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 1;
+        }
+
+        data += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+// the partial sum travels around the ring and comes back to process 0
+static unsigned long long socket_reduce(struct eca_transport *transport,
+                                        unsigned long long value) {
+
+    struct socket_transport *sockets = (struct socket_transport *)transport->data;
+
+    if (transport->processes_num == 1) {
+        return value;
+    }
+
+    unsigned long long sum = 0;
+
+    if (transport->rank == 0) {
+        write_all(sockets->right_fd, &value, sizeof(value));
+        read_all(sockets->left_fd, &sum, sizeof(sum));
+    } else {
+        read_all(sockets->left_fd, &sum, sizeof(sum));
+        sum += value;
+        write_all(sockets->right_fd, &sum, sizeof(sum));
+    }
+
+    return sum;
+}
+
+static void socket_destroy(struct eca_transport *transport) {
+
+    struct socket_transport *sockets = (struct socket_transport *)transport->data;
+
+    close(sockets->left_fd);
+    close(sockets->right_fd);
+    free(sockets);
+    free(transport);
+}
+
+static unsigned char *mailbox(struct shared_memory_header *header,
+                              int processes_num, int rank, int side) {
+
+    unsigned char *mailboxes = (unsigned char *)&header->values[processes_num];
+    return mailboxes + (size_t)(2 * rank + side) * header->max_size;
+}
+
+static int shared_memory_exchange(struct eca_transport *transport,
+                                  const unsigned char *to_left,
+                                  const unsigned char *to_right,
+                                  unsigned char *from_left,
+                                  unsigned char *from_right, int size) {
+
+    struct shared_memory_header *header =
+        ((struct shared_memory_transport *)transport->data)->header;
+
+    int processes_num = transport->processes_num;
+    int left = (transport->rank - 1 + processes_num) % processes_num;
+    int right = (transport->rank + 1) % processes_num;
+
+    if (size > header->max_size) {
+        return 1;
+    }
+
+    memcpy(mailbox(header, processes_num, transport->rank, 0), to_left, size);
+    memcpy(mailbox(header, processes_num, transport->rank, 1), to_right, size);
+    pthread_barrier_wait(&header->barrier);
+
+    memcpy(from_left, mailbox(header, processes_num, left, 1), size);
+    memcpy(from_right, mailbox(header, processes_num, right, 0), size);
+
+    // nobody may overwrite the mailboxes until all neighbours have read them
+    pthread_barrier_wait(&header->barrier);
+
+    return 0;
+}
+
+static unsigned long long shared_memory_reduce(struct eca_transport *transport,
+                                               unsigned long long value) {
+
+    struct shared_memory_header *header =
+        ((struct shared_memory_transport *)transport->data)->header;
+
+    header->values[transport->rank] = value;
+    pthread_barrier_wait(&header->barrier);
+
+    unsigned long long sum = 0;
+    for (int i = 0; i < transport->processes_num; i++) {
+        sum += header->values[i];
+    }
+
+    pthread_barrier_wait(&header->barrier);
+
+    return sum;
+}
+
+static void shared_memory_destroy(struct eca_transport *transport) {
+
+    struct shared_memory_transport *shared =
+        (struct shared_memory_transport *)transport->data;
+
+    munmap(shared->header, shared->length);
+    free(shared);
+    free(transport);
+}
+
+// the parent kills the other processes once it sees this one fail
+static void local_abort(struct eca_transport *transport) {
+
+    (void)transport;
+    fflush(NULL);
+    _exit(1);
+}
+
+// kill the given processes and wait for them
+static void kill_processes(const pid_t *pids, const int *finished, int processes_num) {
+
+    for (int rank = 0; rank < processes_num; rank++) {
+        if (!finished[rank]) {
+            kill(pids[rank], SIGKILL);
+        }
+    }
+
+    for (int rank = 0; rank < processes_num; rank++) {
+        if (!finished[rank]) {
+            waitpid(pids[rank], NULL, 0);
+        }
+    }
+}
+
+static void close_links(int (*links)[2], int links_num) {
+
+    for (int i = 0; i < links_num; i++) {
+        close(links[i][0]);
+        close(links[i][1]);
+    }
+
+    free(links);
+}
+
+// wait for the given processes only, the caller may have other children, on
+// the first failure the rest are killed, since their neighbours are gone,
+// returns 0 if all of them have finished successfully
+static int wait_processes(const pid_t *pids, int *finished, int processes_num) {
+
+    // a blocking wait for one of them would miss an earlier failure of another
+    struct timespec pause = {0, 10000000};
+    int running = processes_num;
+
+    while (running > 0) {
+
+        int reaped = 0;
+        for (int rank = 0; rank < processes_num; rank++) {
+
+            if (finished[rank]) {
+                continue;
+            }
+
+            int status;
+            pid_t pid = waitpid(pids[rank], &status, WNOHANG);
+            if (pid == 0 || (pid < 0 && errno == EINTR)) {
+                continue;
+            }
+
+            finished[rank] = 1;
+            running--;
+            reaped = 1;
+
+            if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                kill_processes(pids, finished, processes_num);
+                return 1;
+            }
+        }
+
+        if (!reaped) {
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    return 0;
+}
+
+int eca_launch_local_processes(enum eca_transport_type type, int processes_num,
+                               int max_size,
+                               int (*run)(struct eca_transport *transport, void *arg),
+                               void *arg) {
+
+    if (processes_num < 1) {
+        return 1;
+    }
+
+    // link i connects process i with its right neighbour
+    int (*links)[2] = NULL;
+    struct shared_memory_header *header = NULL;
+    size_t length = 0;
+
+    if (type == ECA_TRANSPORT_SOCKETS) {
+
+        links = (int(*)[2])malloc(processes_num * sizeof(int[2]));
+        if (links == NULL) {
+            return 1;
+        }
+
+        for (int i = 0; i < processes_num; i++) {
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, links[i]) < 0) {
+                perror("socketpair");
+                close_links(links, i);
+                return 1;
+            }
+        }
+    } else if (type == ECA_TRANSPORT_SHARED_MEMORY) {
+
+        length = sizeof(struct shared_memory_header) +
+                 processes_num * sizeof(unsigned long long) +
+                 (size_t)2 * processes_num * max_size;
+
+        header = (struct shared_memory_header *)mmap(
+            NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (header == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_barrier_init(&header->barrier, &attr, processes_num);
+        pthread_barrierattr_destroy(&attr);
+        header->max_size = max_size;
+    } else {
+        return 1;
+    }
+
+    // do not let the children repeat the buffered output of the parent
+    fflush(NULL);
+
+    pid_t *pids = (pid_t *)malloc(processes_num * sizeof(pid_t));
+    int *finished = (int *)calloc(processes_num, sizeof(int));
+    if (pids == NULL || finished == NULL) {
+        free(pids);
+        free(finished);
+        if (links != NULL) {
+            close_links(links, processes_num);
+        } else {
+            pthread_barrier_destroy(&header->barrier);
+            munmap(header, length);
+        }
+        return 1;
+    }
+
+    int forked_num = processes_num;
+    for (int rank = 0; rank < processes_num; rank++) {
+
+        pids[rank] = fork();
+        if (pids[rank] < 0) {
+            perror("fork");
+            forked_num = rank;
+            break;
+        }
+
+        if (pids[rank] > 0) {
+            continue;
+        }
+
+        struct eca_transport *transport =
+            (struct eca_transport *)malloc(sizeof(struct eca_transport));
+        transport->rank = rank;
+        transport->processes_num = processes_num;
+
+        if (type == ECA_TRANSPORT_SOCKETS) {
+
+            struct socket_transport *sockets =
+                (struct socket_transport *)malloc(sizeof(struct socket_transport));
+            sockets->left_fd = links[(rank - 1 + processes_num) % processes_num][1];
+            sockets->right_fd = links[rank][0];
+
+            // keep only the two ends of this process open
+            for (int i = 0; i < processes_num; i++) {
+                for (int j = 0; j < 2; j++) {
+                    if (links[i][j] != sockets->left_fd &&
+                        links[i][j] != sockets->right_fd) {
+                        close(links[i][j]);
+                    }
+                }
+            }
+
+            transport->abort = local_abort;
+            transport->exchange = socket_exchange;
+            transport->reduce = socket_reduce;
+            transport->destroy = socket_destroy;
+            transport->data = sockets;
+        } else {
+
+            struct shared_memory_transport *shared =
+                (struct shared_memory_transport *)malloc(
+                    sizeof(struct shared_memory_transport));
+            shared->header = header;
+            shared->length = length;
+
+            transport->abort = local_abort;
+            transport->exchange = shared_memory_exchange;
+            transport->reduce = shared_memory_reduce;
+            transport->destroy = shared_memory_destroy;
+            transport->data = shared;
+        }
+
+        int status = run(transport, arg);
+        transport->destroy(transport);
+        fflush(NULL);
+        _exit(status);
+    }
+
+    if (links != NULL) {
+        close_links(links, processes_num);
+    }
+
+    int error = forked_num < processes_num;
+
+    // without all of them the others would wait forever for their neighbours
+    if (error) {
+        kill_processes(pids, finished, forked_num);
+    } else {
+        error = wait_processes(pids, finished, forked_num);
+    }
+
+    free(finished);
+
+    if (header != NULL) {
+        pthread_barrier_destroy(&header->barrier);
+        munmap(header, length);
+    }
+    free(pids);
+
+    return error;
+}
+
+#ifdef ECA_HAVE_MPI
+
+static int mpi_exchange(struct eca_transport *transport, const unsigned char *to_left,
+                        const unsigned char *to_right, unsigned char *from_left,
+                        unsigned char *from_right, int size) {
+
+    int left = (transport->rank - 1 + transport->processes_num) %
+               transport->processes_num;
+    int right = (transport->rank + 1) % transport->processes_num;
+
+    // the first message goes to the right, the second one to the left
+    if (MPI_Sendrecv(to_right, size, MPI_UNSIGNED_CHAR, right, 0, from_left, size,
+                     MPI_UNSIGNED_CHAR, left, 0, MPI_COMM_WORLD,
+                     MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+        return 1;
+    }
+
+    if (MPI_Sendrecv(to_left, size, MPI_UNSIGNED_CHAR, left, 1, from_right, size,
+                     MPI_UNSIGNED_CHAR, right, 1, MPI_COMM_WORLD,
+                     MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static unsigned long long mpi_reduce(struct eca_transport *transport,
+                                     unsigned long long value) {
+
+    (void)transport;
+    unsigned long long sum = 0;
+
+    MPI_Reduce(&value, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    return sum;
+}
+
+static void mpi_abort(struct eca_transport *transport) {
+
+    (void)transport;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    _exit(1);
+}
+
+static void mpi_destroy(struct eca_transport *transport) {
+
+    free(transport);
+    MPI_Finalize();
+}
+
+struct eca_transport *eca_create_mpi_transport(int *argc, char ***argv) {
+
+    MPI_Init(argc, argv);
+
+    struct eca_transport *transport =
+        (struct eca_transport *)malloc(sizeof(struct eca_transport));
+    MPI_Comm_rank(MPI_COMM_WORLD, &transport->rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &transport->processes_num);
+
+    transport->abort = mpi_abort;
+    transport->exchange = mpi_exchange;
+    transport->reduce = mpi_reduce;
+    transport->destroy = mpi_destroy;
+    transport->data = NULL;
+
+    return transport;
+}
+
+#endif
@@ -0,0 +1,63 @@
+// Elementary Cellular Automaton - communication between processes
+// Szymon Golebiowski
+
+#ifndef ECA_TRANSPORT_H
+#define ECA_TRANSPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// processes form a ring, every one of them talks only to its two neighbours
+enum eca_transport_type {
+    ECA_TRANSPORT_SOCKETS,       // Unix socket pairs between local processes
+    ECA_TRANSPORT_SHARED_MEMORY, // shared mailboxes and a barrier
+    ECA_TRANSPORT_MPI,           // available if built with ECA_HAVE_MPI
+};
+
+struct eca_transport {
+
+    int rank;
+    int processes_num;
+
+    // send the buffers to the left and to the right neighbour and receive the
+    // buffers sent by them, each of the given size, returns 0 on success
+    int (*exchange)(struct eca_transport *transport, const unsigned char *to_left,
+                    const unsigned char *to_right, unsigned char *from_left,
+                    unsigned char *from_right, int size);
+
+    // sum the values of all processes, the result is valid in process 0
+    unsigned long long (*reduce)(struct eca_transport *transport,
+                                 unsigned long long value);
+
+    // stop all processes at once when this one cannot go on, so that none of
+    // them waits forever for its messages, does not return
+    void (*abort)(struct eca_transport *transport);
+
+    void (*destroy)(struct eca_transport *transport);
+
+    void *data;
+};
+
+// parse the name of a transport, returns -1 if it is unknown
+int eca_parse_transport_type(const char *name);
+
+// fork processes_num processes connected by a local transport and call the
+// given function in each of them, max_size is the largest exchanged buffer,
+// when one of them fails the others are killed
+// returns 0 if all processes have finished successfully
+int eca_launch_local_processes(enum eca_transport_type type, int processes_num,
+                               int max_size,
+                               int (*run)(struct eca_transport *transport, void *arg),
+                               void *arg);
+
+#ifdef ECA_HAVE_MPI
+// connect the processes started by mpirun
+struct eca_transport *eca_create_mpi_transport(int *argc, char ***argv);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,454 @@
+// Elementary Cellular Automaton - asynchronous file output
+// Szymon Golebiowski
+
+#define _GNU_SOURCE // O_DIRECT
+
+#include "writer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef ECA_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+// alignment of the buffers, sizes and offsets required by O_DIRECT
+#define BLOCK_SIZE 4096
+
+struct batch {
+
+    unsigned char *data;
+    size_t size;
+};
+
+struct eca_writer {
+
+    int fd;
+    int direct;        // whether O_DIRECT is still set
+    int opened_direct; // whether the file has been opened with O_DIRECT
+    int error;
+
+    // ring of batches, the caller fills the head one, the writer thread takes
+    // them from the tail, count includes the batches being written and every
+    // batch is released as soon as it is on the disk
+    struct batch *batches;
+    size_t batch_size;
+    int queue_length;
+    int head;
+    int tail;
+    int count;
+    int closing;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_t thread;
+
+    off_t offset; // used only by the writer thread
+
+#ifdef ECA_HAVE_LIBURING
+    struct io_uring ring;
+    int uring;
+    unsigned char *done; // batches whose write has completed
+#endif
+
+    unsigned long long bytes;
+    unsigned long long batches_num;
+    unsigned long long occupancy_sum;
+    int max_occupancy;
+    double write_seconds;
+    double stall_seconds;
+    double start_time;
+};
+
+static double current_time(void) {
+
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// O_DIRECT writes whole blocks only, the last batch is written through the
+// page cache
+static void prepare_batch(struct eca_writer *writer, const struct batch *batch) {
+
+    if (writer->direct && batch->size % BLOCK_SIZE != 0) {
+        fcntl(writer->fd, F_SETFL, fcntl(writer->fd, F_GETFL) & ~O_DIRECT);
+        writer->direct = 0;
+    }
+}
+
+static int write_batch(struct eca_writer *writer, const struct batch *batch) {
+
+    size_t written = 0;
+    while (written < batch->size) {
+
+        ssize_t n = pwrite(writer->fd, batch->data + written, batch->size - written,
+                           writer->offset + written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 1;
+        }
+
+        written += n;
+    }
+
+    writer->offset += batch->size;
+
+    return 0;
+}
+
+// release the tail batch for the caller, called with the mutex locked
+static void release_batch(struct eca_writer *writer) {
+
+    writer->tail = (writer->tail + 1) % writer->queue_length;
+    writer->count--;
+    pthread_cond_signal(&writer->not_full);
+}
+
+#ifdef ECA_HAVE_LIBURING
+// keep all queued batches submitted and release them in order as they complete,
+// called with the mutex locked until the queue is empty and closed
+static void run_writer_uring(struct eca_writer *writer) {
+
+    // batches from the tail which have been submitted and not released yet
+    int in_flight = 0;
+
+    while (1) {
+
+        while (writer->count == 0 && !writer->closing) {
+            pthread_cond_wait(&writer->not_empty, &writer->mutex);
+        }
+
+        if (writer->count == 0) {
+            break;
+        }
+
+        int first = (writer->tail + in_flight) % writer->queue_length;
+        int batches_num = writer->count - in_flight;
+        pthread_mutex_unlock(&writer->mutex);
+
+        double start = current_time();
+        int error = 0;
+
+        for (int i = 0; i < batches_num; i++) {
+
+            int index = (first + i) % writer->queue_length;
+            struct batch *batch = &writer->batches[index];
+            prepare_batch(writer, batch);
+
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&writer->ring);
+            io_uring_prep_write(sqe, writer->fd, batch->data, batch->size,
+                                writer->offset);
+            io_uring_sqe_set_data(sqe, batch);
+            writer->offset += batch->size;
+        }
+
+        if (batches_num > 0) {
+            io_uring_submit(&writer->ring);
+        }
+
+        // wait for one write, it may complete out of order
+        struct io_uring_cqe *cqe;
+        int lost = io_uring_wait_cqe(&writer->ring, &cqe) < 0;
+        if (lost) {
+            error = 1;
+        } else {
+
+            struct batch *batch = (struct batch *)io_uring_cqe_get_data(cqe);
+            if (cqe->res < 0 || (size_t)cqe->res != batch->size) {
+                error = 1;
+            }
+
+            writer->done[batch - writer->batches] = 1;
+            io_uring_cqe_seen(&writer->ring, cqe);
+        }
+
+        double seconds = current_time() - start;
+
+        pthread_mutex_lock(&writer->mutex);
+        writer->write_seconds += seconds;
+        writer->error |= error;
+        in_flight += batches_num;
+
+        while (in_flight > 0 && writer->done[writer->tail]) {
+            writer->done[writer->tail] = 0;
+            release_batch(writer);
+            in_flight--;
+        }
+
+        // without completions the batches would never be released
+        if (lost) {
+            while (in_flight > 0) {
+                release_batch(writer);
+                in_flight--;
+            }
+        }
+    }
+}
+#endif
+
+static void *run_writer(void *arg) {
+
+    struct eca_writer *writer = (struct eca_writer *)arg;
+
+    pthread_mutex_lock(&writer->mutex);
+
+#ifdef ECA_HAVE_LIBURING
+    if (writer->uring) {
+        run_writer_uring(writer);
+        pthread_mutex_unlock(&writer->mutex);
+        return NULL;
+    }
+#endif
+
+    while (1) {
+
+        while (writer->count == 0 && !writer->closing) {
+            pthread_cond_wait(&writer->not_empty, &writer->mutex);
+        }
+
+        if (writer->count == 0) {
+            break;
+        }
+
+        // write the tail batch only, so that it is given back right away
+        struct batch *batch = &writer->batches[writer->tail];
+        pthread_mutex_unlock(&writer->mutex);
+
+        double start = current_time();
+        prepare_batch(writer, batch);
+        int error = write_batch(writer, batch);
+        double seconds = current_time() - start;
+
+        pthread_mutex_lock(&writer->mutex);
+        writer->write_seconds += seconds;
+        writer->error |= error;
+        release_batch(writer);
+    }
+
+    pthread_mutex_unlock(&writer->mutex);
+
+    return NULL;
+}
+
+// free the buffers and the ring of a writer whose thread is not running, the
+// file is not closed
+static void free_writer(struct eca_writer *writer) {
+
+#ifdef ECA_HAVE_LIBURING
+    if (writer->uring) {
+        io_uring_queue_exit(&writer->ring);
+    }
+    free(writer->done);
+#endif
+
+    if (writer->batches != NULL) {
+        for (int i = 0; i < writer->queue_length; i++) {
+            free(writer->batches[i].data);
+        }
+    }
+
+    free(writer->batches);
+    free(writer);
+}
+
+struct eca_writer *eca_writer_create(const char *path, int queue_length,
+                                     size_t batch_size, int direct) {
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    int fd = -1;
+
+    // not every file system supports O_DIRECT
+    if (direct) {
+        fd = open(path, flags | O_DIRECT, 0644);
+    }
+
+    if (fd < 0) {
+        direct = 0;
+        fd = open(path, flags, 0644);
+    }
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (queue_length < 2) {
+        queue_length = 2;
+    }
+
+    batch_size = (batch_size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    if (batch_size == 0) {
+        batch_size = BLOCK_SIZE;
+    }
+
+    struct eca_writer *writer =
+        (struct eca_writer *)calloc(1, sizeof(struct eca_writer));
+    if (writer == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    writer->fd = fd;
+    writer->direct = direct;
+    writer->opened_direct = direct;
+    writer->batch_size = batch_size;
+    writer->queue_length = queue_length;
+    writer->batches = (struct batch *)calloc(queue_length, sizeof(struct batch));
+
+    int error = writer->batches == NULL;
+    for (int i = 0; i < queue_length && !error; i++) {
+
+        // posix_memalign does not set errno, the caller reports it
+        void *data;
+        int code = posix_memalign(&data, BLOCK_SIZE, batch_size);
+        if (code != 0) {
+            errno = code;
+            error = 1;
+            data = NULL;
+        }
+
+        writer->batches[i].data = (unsigned char *)data;
+    }
+
+#ifdef ECA_HAVE_LIBURING
+    if (!error) {
+        writer->uring = io_uring_queue_init(queue_length, &writer->ring, 0) == 0;
+        writer->done = (unsigned char *)calloc(queue_length, 1);
+        error = writer->done == NULL;
+    }
+#endif
+
+    if (!error) {
+
+        pthread_mutex_init(&writer->mutex, NULL);
+        pthread_cond_init(&writer->not_empty, NULL);
+        pthread_cond_init(&writer->not_full, NULL);
+
+        writer->start_time = current_time();
+        if (pthread_create(&writer->thread, NULL, run_writer, writer) != 0) {
+            pthread_mutex_destroy(&writer->mutex);
+            pthread_cond_destroy(&writer->not_empty);
+            pthread_cond_destroy(&writer->not_full);
+            error = 1;
+        }
+    }
+
+    if (error) {
+        close(fd);
+        free_writer(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+// pass the head batch to the writer thread, wait_for_free is cleared only when
+// there will be no more batches
+static int queue_batch(struct eca_writer *writer, int wait_for_free) {
+
+    pthread_mutex_lock(&writer->mutex);
+
+    writer->bytes += writer->batches[writer->head].size;
+    writer->batches_num++;
+    writer->count++;
+    writer->occupancy_sum += writer->count;
+    if (writer->count > writer->max_occupancy) {
+        writer->max_occupancy = writer->count;
+    }
+
+    writer->head = (writer->head + 1) % writer->queue_length;
+    pthread_cond_signal(&writer->not_empty);
+
+    // the next head batch is free once the queue is not full
+    if (wait_for_free && writer->count == writer->queue_length) {
+
+        double start = current_time();
+        while (writer->count == writer->queue_length) {
+            pthread_cond_wait(&writer->not_full, &writer->mutex);
+        }
+        writer->stall_seconds += current_time() - start;
+    }
+
+    int error = writer->error;
+    pthread_mutex_unlock(&writer->mutex);
+
+    if (wait_for_free) {
+        writer->batches[writer->head].size = 0;
+    }
+
+    return error;
+}
+
+int eca_writer_write(struct eca_writer *writer, const void *data, size_t size) {
+
+    const unsigned char *bytes = (const unsigned char *)data;
+    int error = 0;
+
+    while (size > 0 && !error) {
+
+        struct batch *batch = &writer->batches[writer->head];
+
+        size_t n = writer->batch_size - batch->size;
+        if (n > size) {
+            n = size;
+        }
+
+        memcpy(batch->data + batch->size, bytes, n);
+        batch->size += n;
+        bytes += n;
+        size -= n;
+
+        if (batch->size == writer->batch_size) {
+            error = queue_batch(writer, 1);
+        }
+    }
+
+    return error;
+}
+
+int eca_writer_close(struct eca_writer *writer, struct eca_writer_stats *stats) {
+
+    if (writer->batches[writer->head].size > 0) {
+        queue_batch(writer, 0);
+    }
+
+    pthread_mutex_lock(&writer->mutex);
+    writer->closing = 1;
+    pthread_cond_signal(&writer->not_empty);
+    pthread_mutex_unlock(&writer->mutex);
+
+    pthread_join(writer->thread, NULL);
+
+    int error = writer->error;
+    error |= close(writer->fd) != 0;
+
+    if (stats != NULL) {
+
+        stats->bytes = writer->bytes;
+        stats->batches = writer->batches_num;
+        stats->average_occupancy =
+            writer->batches_num ? (double)writer->occupancy_sum / writer->batches_num : 0;
+        stats->max_occupancy = writer->max_occupancy;
+        stats->queue_length = writer->queue_length;
+        stats->write_seconds = writer->write_seconds;
+        stats->stall_seconds = writer->stall_seconds;
+        stats->total_seconds = current_time() - writer->start_time;
+        stats->direct = writer->opened_direct;
+    }
+
+    pthread_mutex_destroy(&writer->mutex);
+    pthread_cond_destroy(&writer->not_empty);
+    pthread_cond_destroy(&writer->not_full);
+    free_writer(writer);
+
+    return error;
+}
@@ -0,0 +1,51 @@
+// Elementary Cellular Automaton - asynchronous file output
+// Szymon Golebiowski
+
+#ifndef ECA_WRITER_H
+#define ECA_WRITER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the data is gathered into large aligned batches which are passed through a
+// bounded queue to a dedicated thread writing them to the disk (with io_uring
+// if built with ECA_HAVE_LIBURING), the caller blocks only when the queue is full
+struct eca_writer;
+
+struct eca_writer_stats {
+
+    unsigned long long bytes;
+    unsigned long long batches;
+    double average_occupancy; // queued batches seen by every new batch
+    int max_occupancy;
+    int queue_length;
+    double write_seconds;     // time spent by the writer thread on writing
+    double stall_seconds;     // time the caller waited for a free batch
+    double total_seconds;     // time from creation till closing
+    int direct;               // whether O_DIRECT has been used
+};
+
+#define ECA_DEFAULT_QUEUE_LENGTH 8
+#define ECA_DEFAULT_BATCH_SIZE (4 << 20)
+
+// open the file for writing, batch_size is rounded up to the block size, with
+// direct set the page cache is bypassed if the file system allows it
+// returns NULL if the file cannot be opened or when out of memory
+struct eca_writer *eca_writer_create(const char *path, int queue_length,
+                                     size_t batch_size, int direct);
+
+// append the data to the file, returns 0 on success
+int eca_writer_write(struct eca_writer *writer, const void *data, size_t size);
+
+// write the remaining data, close the file and free the writer, the statistics
+// are stored if stats is not NULL, returns 0 if all data has been written
+int eca_writer_close(struct eca_writer *writer, struct eca_writer_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif